@@ -19,7 +19,9 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QDebug>
-#include <QApplication>
+#include <QCoreApplication>
+#include <QDir>
+#include <QSysInfo>
 
 Config* Config::s_instance = nullptr;
 
@@ -46,13 +48,31 @@ void Config::setDefaults() {
     m_keyColor = "#444444";
     m_keyActiveColor = "#0096FF";
     m_fontFamily = "monospace";
+    m_targetFps = 0;
     m_defaultLayout = "104keys";
+    m_storageEnabled = true;
+    m_storageDirectory = "data";
+    m_storageSyncIntervalMs = 5000;
+    m_chordWindowMs = 30;
+    m_hubListenPort = 0;
+    m_hubListenAddress = "127.0.0.1";
+    m_hubConnect.clear();
+    m_hubName.clear();
+}
+
+QString Config::storageDirectory() const {
+    QString directory = m_storageDirectory.isEmpty() ? QString("data") : m_storageDirectory;
+    return QDir(QCoreApplication::applicationDirPath()).absoluteFilePath(directory);
+}
+
+QString Config::hubName() const {
+    return m_hubName.isEmpty() ? QSysInfo::machineHostName() : m_hubName;
 }
 
 void Config::load(const QString& filePath) {
     QString configFile = filePath;
     if (configFile.isEmpty()) {
-        configFile = QApplication::applicationDirPath() + "/config.json";
+        configFile = QCoreApplication::applicationDirPath() + "/config.json";
     }
     
     QFile file(configFile);
@@ -71,8 +91,22 @@ void Config::load(const QString& filePath) {
         return;
     }
     
+    // Sections missing from the file fall back to their defaults, also
+    // when the file is reloaded.
+    setDefaults();
     loadFromJson(doc.object());
+    applyOverrides();
     qDebug() << "Config loaded from:" << configFile;
+    emit changed();
+}
+
+void Config::applyOverrides() {
+    if (m_serverPortOverride != 0) {
+        m_serverPort = m_serverPortOverride;
+    }
+    if (!m_defaultLayoutOverride.isEmpty()) {
+        m_defaultLayout = m_defaultLayoutOverride;
+    }
 }
 
 void Config::loadFromJson(const QJsonObject& json) {
@@ -91,18 +125,39 @@ void Config::loadFromJson(const QJsonObject& json) {
         m_keyColor = display["keyColor"].toString("#444444");
         m_keyActiveColor = display["keyActiveColor"].toString("#0096FF");
         m_fontFamily = display["fontFamily"].toString("monospace");
+        m_targetFps = display["targetFps"].toInt(0);
     }
     
     if (json.contains("layout")) {
         QJsonObject layout = json["layout"].toObject();
         m_defaultLayout = layout["default"].toString("104keys");
     }
+    
+    if (json.contains("storage")) {
+        QJsonObject storage = json["storage"].toObject();
+        m_storageEnabled = storage["enabled"].toBool(true);
+        m_storageDirectory = storage["directory"].toString("data");
+        m_storageSyncIntervalMs = qMax(100, storage["syncIntervalMs"].toInt(5000));
+    }
+    
+    if (json.contains("analysis")) {
+        QJsonObject analysis = json["analysis"].toObject();
+        m_chordWindowMs = qMax(0, analysis["chordWindowMs"].toInt(30));
+    }
+
+    if (json.contains("hub")) {
+        QJsonObject hub = json["hub"].toObject();
+        m_hubListenPort = static_cast<quint16>(hub["listenPort"].toInt(0));
+        m_hubListenAddress = hub["listenAddress"].toString("127.0.0.1");
+        m_hubConnect = hub["connect"].toString();
+        m_hubName = hub["name"].toString();
+    }
 }
 
 void Config::save(const QString& filePath) {
     QString configFile = filePath;
     if (configFile.isEmpty()) {
-        configFile = QApplication::applicationDirPath() + "/config.json";
+        configFile = QCoreApplication::applicationDirPath() + "/config.json";
     }
     
     QFile file(configFile);
@@ -134,11 +189,29 @@ QJsonObject Config::saveToJson() const {
     display["keyColor"] = m_keyColor;
     display["keyActiveColor"] = m_keyActiveColor;
     display["fontFamily"] = m_fontFamily;
+    display["targetFps"] = m_targetFps;
     json["display"] = display;
     
     QJsonObject layout;
     layout["default"] = m_defaultLayout;
     json["layout"] = layout;
     
+    QJsonObject storage;
+    storage["enabled"] = m_storageEnabled;
+    storage["directory"] = m_storageDirectory;
+    storage["syncIntervalMs"] = m_storageSyncIntervalMs;
+    json["storage"] = storage;
+    
+    QJsonObject analysis;
+    analysis["chordWindowMs"] = m_chordWindowMs;
+    json["analysis"] = analysis;
+
+    QJsonObject hub;
+    hub["listenPort"] = m_hubListenPort;
+    hub["listenAddress"] = m_hubListenAddress;
+    hub["connect"] = m_hubConnect;
+    hub["name"] = m_hubName;
+    json["hub"] = hub;
+    
     return json;
 }
@@ -40,16 +40,44 @@ public:
     QString keyColor() const { return m_keyColor; }
     QString keyActiveColor() const { return m_keyActiveColor; }
     QString fontFamily() const { return m_fontFamily; }
+    // Overlay window repaint rate; 0 follows the monitor refresh rate.
+    int targetFps() const { return m_targetFps; }
     
     QString defaultLayout() const { return m_defaultLayout; }
 
-    void setServerPort(quint16 port) { m_serverPort = port; }
-    void setDefaultLayout(const QString& layout) { m_defaultLayout = layout; }
+    bool storageEnabled() const { return m_storageEnabled; }
+    // Resolved against the application directory when relative or empty.
+    QString storageDirectory() const;
+    int storageSyncIntervalMs() const { return m_storageSyncIntervalMs; }
+
+    // Presses within this many ms of the first one count as a chord.
+    int chordWindowMs() const { return m_chordWindowMs; }
+
+    // Hub mode: aggregate nodes on this port (0 = off), and/or forward this
+    // instance's input to the hub at "host[:port]" under hubName(). The hub
+    // has no authentication and listens on hubListenAddress(), localhost
+    // unless configured otherwise.
+    quint16 hubListenPort() const { return m_hubListenPort; }
+    QString hubListenAddress() const { return m_hubListenAddress; }
+    QString hubConnect() const { return m_hubConnect; }
+    // Defaults to the machine's host name.
+    QString hubName() const;
+
+    // Runtime overrides, e.g. a free port picked at startup. They outlive
+    // reloads of the config file.
+    void setServerPort(quint16 port) { m_serverPort = m_serverPortOverride = port; }
+    void setDefaultLayout(const QString& layout) { m_defaultLayout = m_defaultLayoutOverride = layout; }
+
+signals:
+    // Emitted after a config file has been loaded, including reloads after
+    // the file changed on disk.
+    void changed();
 
 private:
     explicit Config(QObject* parent = nullptr);
     void setDefaults();
     void loadFromJson(const QJsonObject& json);
+    void applyOverrides();
     QJsonObject saveToJson() const;
     
     static Config* s_instance;
@@ -64,8 +92,23 @@ private:
     QString m_keyColor = "#444444";
     QString m_keyActiveColor = "#0096FF";
     QString m_fontFamily = "monospace";
+    int m_targetFps = 0;
     
     QString m_defaultLayout = "104keys";
+
+    bool m_storageEnabled = true;
+    QString m_storageDirectory = "data";
+    int m_storageSyncIntervalMs = 5000;
+
+    int m_chordWindowMs = 30;
+
+    quint16 m_hubListenPort = 0;
+    QString m_hubListenAddress = "127.0.0.1";
+    QString m_hubConnect;
+    QString m_hubName;
+
+    quint16 m_serverPortOverride = 0;
+    QString m_defaultLayoutOverride;
 };
 
 #endif
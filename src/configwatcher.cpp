@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "configwatcher.h"
+#include "metrics.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+ConfigWatcher::ConfigWatcher(const QString& configFile, const QString& layoutDirectory, QObject* parent)
+    : QObject(parent)
+    , m_configFile(QFileInfo(configFile).absoluteFilePath())
+    , m_layoutDirectory(QDir(layoutDirectory).absolutePath())
+{
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &ConfigWatcher::onFileChanged);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &ConfigWatcher::onDirectoryChanged);
+
+    m_debounce = new QTimer(this);
+    m_debounce->setSingleShot(true);
+    m_debounce->setInterval(DebounceMs);
+    connect(m_debounce, &QTimer::timeout, this, [this]() {
+        Metrics::instance()->add(Metrics::TimerWakeups);
+        settle();
+    });
+
+    // The directory is watched too: it sees config.json being replaced and
+    // layouts being added or removed.
+    const QString configDirectory = QFileInfo(m_configFile).absolutePath();
+    m_watcher->addPath(configDirectory);
+    if (QFileInfo(m_layoutDirectory).isDir() && m_layoutDirectory != configDirectory) {
+        m_watcher->addPath(m_layoutDirectory);
+    }
+    m_layoutFiles = scanLayouts();
+    watchFiles();
+}
+
+QStringList ConfigWatcher::scanLayouts() const {
+    QStringList files;
+    QDir dir(m_layoutDirectory);
+    for (const QString& name : dir.entryList(QStringList() << "*.json", QDir::Files | QDir::Readable, QDir::Name)) {
+        files.append(dir.absoluteFilePath(name));
+    }
+    return files;
+}
+
+void ConfigWatcher::watchFiles() {
+    QStringList paths = m_layoutFiles;
+    if (QFileInfo::exists(m_configFile)) {
+        paths.append(m_configFile);
+    }
+    const QStringList watched = m_watcher->files();
+    for (const QString& path : paths) {
+        if (!watched.contains(path)) {
+            m_watcher->addPath(path);
+        }
+    }
+}
+
+void ConfigWatcher::onFileChanged(const QString& path) {
+    m_pendingFiles.insert(path);
+    m_debounce->start();
+}
+
+void ConfigWatcher::onDirectoryChanged(const QString& path) {
+    if (path == m_layoutDirectory) {
+        m_directoryPending = true;
+    }
+    m_debounce->start();
+}
+
+void ConfigWatcher::settle() {
+    if (m_directoryPending) {
+        m_directoryPending = false;
+        const QStringList files = scanLayouts();
+        if (files != m_layoutFiles) {
+            for (const QString& file : files) {
+                if (!m_layoutFiles.contains(file)) {
+                    m_pendingFiles.insert(file);
+                }
+            }
+            m_layoutFiles = files;
+            emit layoutListChanged(m_layoutFiles);
+        }
+    }
+
+    // A file that exists but is no longer watched was replaced by a rename.
+    const QStringList watched = m_watcher->files();
+    if (QFileInfo::exists(m_configFile) && !watched.contains(m_configFile)) {
+        m_pendingFiles.insert(m_configFile);
+    }
+    for (const QString& file : m_layoutFiles) {
+        if (!watched.contains(file)) {
+            m_pendingFiles.insert(file);
+        }
+    }
+
+    const QSet<QString> pending = m_pendingFiles;
+    m_pendingFiles.clear();
+    watchFiles();
+
+    for (const QString& file : pending) {
+        if (!QFileInfo::exists(file)) {
+            continue;
+        }
+        if (file == m_configFile) {
+            qDebug() << "Config file changed:" << file;
+            emit configChanged(file);
+        } else if (m_layoutFiles.contains(file)) {
+            qDebug() << "Layout file changed:" << file;
+            emit layoutChanged(file);
+        }
+    }
+}
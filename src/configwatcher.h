@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef CONFIGWATCHER_H
+#define CONFIGWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
+#include <QStringList>
+
+// Watches config.json and the layouts directory and reports which files
+// changed once they have been quiet for DebounceMs, so an editor's save
+// (often truncate + write, or write to a temporary file + rename) is
+// reported once. Files replaced by a rename drop out of
+// QFileSystemWatcher and are added back after each change.
+class ConfigWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int DebounceMs = 250;
+
+    ConfigWatcher(const QString& configFile, const QString& layoutDirectory, QObject* parent = nullptr);
+
+    QStringList layoutFiles() const { return m_layoutFiles; }
+
+signals:
+    void configChanged(const QString& filePath);
+    // A layout file was modified or added.
+    void layoutChanged(const QString& filePath);
+    // Layout files were added or removed.
+    void layoutListChanged(const QStringList& filePaths);
+
+private:
+    void onFileChanged(const QString& path);
+    void onDirectoryChanged(const QString& path);
+    void settle();
+    void watchFiles();
+    QStringList scanLayouts() const;
+
+    QFileSystemWatcher* m_watcher = nullptr;
+    QTimer* m_debounce = nullptr;
+    QString m_configFile;
+    QString m_layoutDirectory;
+    QStringList m_layoutFiles;
+    QSet<QString> m_pendingFiles;
+    bool m_directoryPending = false;
+};
+
+#endif
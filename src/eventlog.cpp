@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "eventlog.h"
+#include "keystats.h"
+#include "historystore.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDebug>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const char SegmentMagic[8] = { 'K', 'S', 'E', 'V', 'L', 'O', 'G', '1' };
+const quint32 SegmentVersion = 1;
+const quint32 SnapshotMagic = 0x4B53534E;  // "KSSN"
+const quint32 SnapshotVersion = 1;
+const char SnapshotFileName[] = "snapshot.bin";
+const char HistoryFileName[] = "history.bin";
+
+struct SegmentHeader {
+    char magic[8];
+    quint32 version;
+    quint32 recordSize;
+    qint64 baseTimeMs;
+    quint32 recordCount;
+    quint32 reserved;
+};
+
+static_assert(sizeof(SegmentHeader) == EventLog::HeaderSize, "segment header size");
+
+// A position in the log: segment base time and record index within it.
+struct LogPosition {
+    qint64 baseTimeMs = -1;
+    quint32 index = 0;
+
+    bool covers(qint64 base, quint32 i) const {
+        return base < baseTimeMs || (base == baseTimeMs && i < index);
+    }
+};
+
+}
+
+EventLog::EventLog(QObject* parent)
+    : QObject(parent)
+{
+    // Armed by the first append after a sync, so an idle log never wakes.
+    m_syncTimer = new QTimer(this);
+    m_syncTimer->setSingleShot(true);
+    m_syncTimer->setInterval(5000);
+    connect(m_syncTimer, &QTimer::timeout, this, [this]() {
+        Metrics::instance()->add(Metrics::TimerWakeups);
+        sync();
+    });
+}
+
+EventLog::~EventLog() {
+    close();
+}
+
+QString EventLog::segmentName(qint64 baseTimeMs) {
+    return QString("events-%1.log").arg(baseTimeMs, 13, 10, QChar('0'));
+}
+
+// -1 for names that are not segment names.
+qint64 EventLog::segmentBaseTime(const QString& name) {
+    bool ok = false;
+    const qint64 baseTimeMs = name.mid(7, name.size() - 11).toLongLong(&ok);
+    return ok ? baseTimeMs : -1;
+}
+
+bool EventLog::open(const QString& directory, RestoredCounts* restored, HistoryStore* history) {
+    close();
+    m_directory = directory;
+    m_snapshotBaseTimeMs = -1;
+    m_historyBaseTimeMs = -1;
+    m_prunedBelowMs = -1;
+    if (!QDir().mkpath(directory)) {
+        qWarning() << "Cannot create storage directory:" << directory;
+        return false;
+    }
+
+    if (restored) {
+        restore(*restored, history);
+    }
+
+    m_openTimeMs = QDateTime::currentMSecsSinceEpoch();
+    m_clock.start();
+    if (!startSegment()) {
+        return false;
+    }
+    m_open = true;
+    qDebug() << "Event log opened:" << m_file.fileName();
+    return true;
+}
+
+void EventLog::close() {
+    if (!m_open) return;
+    m_open = false;
+    m_syncTimer->stop();
+    finishSegment();
+    writeSnapshot();
+    writeHistory();
+}
+
+bool EventLog::startSegment() {
+    m_baseTimeMs = m_openTimeMs + m_clock.elapsed();
+    m_file.setFileName(QDir(m_directory).filePath(segmentName(m_baseTimeMs)));
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !m_file.resize(SegmentSize)) {
+        qWarning() << "Cannot create event log segment:" << m_file.fileName() << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    m_map = m_file.map(0, SegmentSize);
+    if (!m_map) {
+        qWarning() << "Cannot map event log segment:" << m_file.fileName() << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    SegmentHeader header = {};
+    std::memcpy(header.magic, SegmentMagic, sizeof(header.magic));
+    header.version = SegmentVersion;
+    header.recordSize = sizeof(Record);
+    header.baseTimeMs = m_baseTimeMs;
+    std::memcpy(m_map, &header, sizeof(header));
+
+    m_recordCount = 0;
+    m_syncedCount = 0;
+    return true;
+}
+
+// Flushes, unmaps and trims the segment to the records actually written.
+void EventLog::finishSegment() {
+    if (!m_map) return;
+    flushMapping();
+    m_file.unmap(m_map);
+    m_map = nullptr;
+    m_file.resize(HeaderSize + static_cast<qint64>(m_recordCount) * sizeof(Record));
+    m_file.close();
+}
+
+// Starts a segment after a failed rollover, throttled so a full disk is
+// not hit on every event.
+bool EventLog::retrySegment() {
+    if (m_clock.elapsed() < m_retryAtMs) {
+        return false;
+    }
+    if (startSegment()) {
+        qDebug() << "Event log resumed:" << m_file.fileName();
+        return true;
+    }
+    m_retryAtMs = m_clock.elapsed() + RetryIntervalMs;
+    return false;
+}
+
+void EventLog::append(int vkCode, quint8 flags) {
+    if (!m_open) return;
+
+    qint64 offsetMs = m_openTimeMs + m_clock.elapsed() - m_baseTimeMs;
+    if (!m_map || m_recordCount == RecordsPerSegment || offsetMs > 0xFFFFFFFFLL) {
+        if (m_map) {
+            finishSegment();
+            m_retryAtMs = 0;
+        }
+        if (!retrySegment()) {
+            Metrics::instance()->add(Metrics::EventLogLost);
+            // The sync tick retries too, in case no further event comes.
+            if (!m_syncTimer->isActive()) {
+                m_syncTimer->start();
+            }
+            return;
+        }
+        offsetMs = 0;
+    }
+
+    Record record;
+    record.timeOffsetMs = static_cast<quint32>(offsetMs);
+    record.vkCode = static_cast<quint8>(vkCode);
+    record.flags = static_cast<quint8>(flags | FlagValid);
+    record.reserved = 0;
+    std::memcpy(m_map + HeaderSize + static_cast<qint64>(m_recordCount) * sizeof(Record), &record, sizeof(record));
+    ++m_recordCount;
+    ++m_recordsWritten;
+
+    if (!m_syncTimer->isActive()) {
+        m_syncTimer->start();
+    }
+}
+
+void EventLog::flushMapping() {
+    if (!m_map || m_syncedCount == m_recordCount) return;
+
+    std::memcpy(m_map + offsetof(SegmentHeader, recordCount), &m_recordCount, sizeof(m_recordCount));
+    const size_t length = HeaderSize + static_cast<size_t>(m_recordCount) * sizeof(Record);
+#ifdef Q_OS_WIN
+    FlushViewOfFile(m_map, length);
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(m_file.handle())));
+#else
+    msync(m_map, length, MS_SYNC);
+#endif
+    m_syncedCount = m_recordCount;
+}
+
+void EventLog::sync() {
+    if (!m_open) return;
+    if (!m_map) {
+        retrySegment();
+    }
+    flushMapping();
+    writeSnapshot();
+    if (++m_syncsSinceHistory >= HistorySyncInterval) {
+        writeHistory();
+    }
+}
+
+// The snapshot records the log position it covers; everything after that
+// position is replayed on restore.
+bool EventLog::writeSnapshot() {
+    if (!m_stats) return false;
+
+    QSaveFile file(QDir(m_directory).filePath(SnapshotFileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write snapshot:" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << SnapshotMagic << SnapshotVersion
+        << static_cast<qint64>(m_openTimeMs + m_clock.elapsed())
+        << m_baseTimeMs << m_recordCount
+        << static_cast<qint32>(m_stats->totalKeyPresses());
+    const KeyCounts& counts = m_stats->keyCounts();
+    for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+        out << static_cast<qint32>(counts.value(vk));
+    }
+    if (!file.commit()) {
+        return false;
+    }
+    m_snapshotBaseTimeMs = m_baseTimeMs;
+    pruneSegments();
+    return true;
+}
+
+// Like the snapshot, the history file starts with the log position it
+// covers.
+bool EventLog::writeHistory() {
+    if (!m_stats) return false;
+    m_syncsSinceHistory = 0;
+
+    QSaveFile file(QDir(m_directory).filePath(HistoryFileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write history:" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << m_baseTimeMs << m_recordCount;
+    m_stats->history().save(out);
+    if (!file.commit()) {
+        return false;
+    }
+    m_historyBaseTimeMs = m_baseTimeMs;
+    pruneSegments();
+    return true;
+}
+
+// Deletes the segments older than both the snapshot and the history
+// positions; restore would skip them anyway. Until both files have been
+// written in this session, the ones on disk may still point into older
+// segments, so nothing is deleted.
+void EventLog::pruneSegments() {
+    if (m_snapshotBaseTimeMs < 0 || m_historyBaseTimeMs < 0) return;
+    const qint64 coveredBelowMs = qMin(m_snapshotBaseTimeMs, m_historyBaseTimeMs);
+    if (coveredBelowMs <= m_prunedBelowMs) return;
+    m_prunedBelowMs = coveredBelowMs;
+
+    QDir dir(m_directory);
+    for (const QString& name : dir.entryList({"events-*.log"}, QDir::Files, QDir::Name)) {
+        const qint64 baseTimeMs = segmentBaseTime(name);
+        if (baseTimeMs < 0 || baseTimeMs >= coveredBelowMs) continue;
+        if (dir.remove(name)) {
+            qDebug() << "Deleted covered event log segment:" << name;
+        } else {
+            qWarning() << "Cannot delete event log segment:" << dir.filePath(name);
+        }
+    }
+}
+
+bool EventLog::restore(RestoredCounts& restored, HistoryStore* history) {
+    LogPosition snapshotPosition;
+
+    QFile snapshot(QDir(m_directory).filePath(SnapshotFileName));
+    if (snapshot.open(QIODevice::ReadOnly)) {
+        QDataStream in(&snapshot);
+        in.setByteOrder(QDataStream::LittleEndian);
+        quint32 magic = 0, version = 0;
+        qint64 writtenMs = 0;
+        qint32 total = 0;
+        in >> magic >> version >> writtenMs >> snapshotPosition.baseTimeMs >> snapshotPosition.index >> total;
+        RestoredCounts fromSnapshot;
+        for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+            qint32 count = 0;
+            in >> count;
+            fromSnapshot.counts[vk] = count;
+        }
+        if (in.status() == QDataStream::Ok && magic == SnapshotMagic && version == SnapshotVersion) {
+            restored = fromSnapshot;
+            restored.totalKeyPresses = total;
+        } else {
+            qWarning() << "Ignoring unreadable snapshot:" << snapshot.fileName();
+            snapshotPosition = LogPosition();
+        }
+    }
+
+    // Without a readable history file the history is rebuilt from the log.
+    LogPosition historyPosition;
+    if (history) {
+        QFile file(QDir(m_directory).filePath(HistoryFileName));
+        if (file.open(QIODevice::ReadOnly)) {
+            QDataStream in(&file);
+            in.setByteOrder(QDataStream::LittleEndian);
+            LogPosition position;
+            in >> position.baseTimeMs >> position.index;
+            if (history->load(in)) {
+                historyPosition = position;
+            } else {
+                qWarning() << "Ignoring unreadable history:" << file.fileName();
+            }
+        }
+    }
+    const LogPosition& replayFrom = history && snapshotPosition.covers(historyPosition.baseTimeMs, historyPosition.index)
+        ? historyPosition : snapshotPosition;
+
+    // Segment names sort chronologically.
+    const QStringList segments = QDir(m_directory).entryList({"events-*.log"}, QDir::Files, QDir::Name);
+    for (const QString& name : segments) {
+        // Covered segments are skipped by name, without opening them.
+        if (segmentBaseTime(name) < replayFrom.baseTimeMs) continue;
+        QFile file(QDir(m_directory).filePath(name));
+        if (!file.open(QIODevice::ReadOnly) || file.size() < HeaderSize) continue;
+        uchar* data = file.map(0, file.size());
+        if (!data) continue;
+
+        SegmentHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, SegmentMagic, sizeof(header.magic)) != 0
+            || header.recordSize != sizeof(Record) || header.baseTimeMs < replayFrom.baseTimeMs) {
+            file.unmap(data);
+            continue;
+        }
+
+        const quint32 available = static_cast<quint32>((file.size() - HeaderSize) / sizeof(Record));
+        for (quint32 i = header.baseTimeMs == replayFrom.baseTimeMs ? replayFrom.index : 0; i < available; ++i) {
+            Record record;
+            std::memcpy(&record, data + HeaderSize + static_cast<qint64>(i) * sizeof(Record), sizeof(record));
+            if (!(record.flags & FlagValid)) break;
+
+            if (history && !historyPosition.covers(header.baseTimeMs, i)
+                && !(record.flags & (FlagReset | FlagRelease))) {
+                history->record(header.baseTimeMs + record.timeOffsetMs, record.vkCode);
+            }
+            if (snapshotPosition.covers(header.baseTimeMs, i)) continue;
+
+            if (record.flags & FlagReset) {
+                std::fill(std::begin(restored.counts), std::end(restored.counts), 0);
+                restored.totalKeyPresses = 0;
+            } else if (!(record.flags & FlagRelease)) {
+                ++restored.counts[record.vkCode];
+                ++restored.totalKeyPresses;
+            }
+            ++restored.replayedRecords;
+        }
+        file.unmap(data);
+    }
+
+    qDebug() << "Restored" << restored.totalKeyPresses << "key presses,"
+             << restored.replayedRecords << "log records replayed";
+    return true;
+}
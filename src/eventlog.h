@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include "vkbitmap.h"
+
+class KeyStats;
+class HistoryStore;
+
+// Append-only binary log of key events, written into preallocated
+// memory-mapped segment files, plus a snapshot of the press counters so a
+// restart restores the totals without replaying the whole history. The
+// time-bucketed history is saved the same way, less often since it is larger.
+//
+// Segment file (events-<baseTimeMs>.log):
+//   header: "KSEVLOG1", u32 version, u32 record size, i64 base time (ms
+//           since epoch), u32 record count (as of the last sync), u32 0
+//   records: u32 ms since base, u8 vk, u8 flags, u16 0
+// Records are only valid with FlagValid set, so the zero-filled tail of a
+// segment that was not synced before a crash reads as end of log. Once both
+// the snapshot and the history have been written from a later segment,
+// older segments are no longer needed for restore and are deleted.
+class EventLog : public QObject {
+    Q_OBJECT
+
+public:
+    enum Flag : quint8 {
+        FlagRelease = 0x01,
+        FlagReset = 0x02,   // counters were reset; vk is unused
+        FlagValid = 0x80
+    };
+
+    struct Record {
+        quint32 timeOffsetMs;
+        quint8 vkCode;
+        quint8 flags;
+        quint16 reserved;
+    };
+    static_assert(sizeof(Record) == 8, "EventLog::Record must stay 8 bytes");
+
+    // Counters as restored from the snapshot and the log tail after it.
+    struct RestoredCounts {
+        int counts[VkBitmap::Size] = {};
+        int totalKeyPresses = 0;
+        quint64 replayedRecords = 0;
+    };
+
+    static constexpr int HeaderSize = 32;
+    static constexpr qint64 SegmentSize = 4 * 1024 * 1024;
+    static constexpr quint32 RecordsPerSegment = (SegmentSize - HeaderSize) / sizeof(Record);
+    static constexpr int HistorySyncInterval = 12;
+    static constexpr qint64 RetryIntervalMs = 1000;
+
+    explicit EventLog(QObject* parent = nullptr);
+    ~EventLog();
+
+    // Restores counters (and history, if given) from the directory, then
+    // starts a new segment.
+    bool open(const QString& directory, RestoredCounts* restored = nullptr,
+              HistoryStore* history = nullptr);
+    void close();
+    bool isOpen() const { return m_open; }
+
+    void setStats(const KeyStats* stats) { m_stats = stats; }
+    void setSyncInterval(int ms) { m_syncTimer->setInterval(ms); }
+
+    // Called on the stats thread after an event was accepted. Costs a
+    // clock read and an 8-byte store into the mapping. If a new segment
+    // cannot be started the event is counted as lost, and starting one is
+    // retried at most every RetryIntervalMs on later appends and syncs.
+    void append(int vkCode, quint8 flags);
+
+    // Flushes the mapping to disk and rewrites the snapshot; every
+    // HistorySyncInterval syncs the history is rewritten too.
+    void sync();
+
+    quint64 recordsWritten() const { return m_recordsWritten; }
+
+private:
+    bool startSegment();
+    bool retrySegment();
+    void finishSegment();
+    void flushMapping();
+    bool writeSnapshot();
+    bool writeHistory();
+    bool restore(RestoredCounts& restored, HistoryStore* history);
+    void pruneSegments();
+    static QString segmentName(qint64 baseTimeMs);
+    static qint64 segmentBaseTime(const QString& name);
+
+    QString m_directory;
+    bool m_open = false;
+    qint64 m_retryAtMs = 0;     // m_clock time of the next retry without a segment
+    QFile m_file;
+    uchar* m_map = nullptr;
+    qint64 m_baseTimeMs = 0;
+    quint32 m_recordCount = 0;
+    quint32 m_syncedCount = 0;
+
+    // Wall clock at open plus a monotonic offset, so appends never call
+    // into the system time and stay ordered.
+    qint64 m_openTimeMs = 0;
+    QElapsedTimer m_clock;
+
+    const KeyStats* m_stats = nullptr;
+    QTimer* m_syncTimer = nullptr;
+    quint64 m_recordsWritten = 0;
+    int m_syncsSinceHistory = 0;
+
+    // Base time of the segment the snapshot and the history were last
+    // written from in this session (-1: not yet), and the base time below
+    // which segments have already been deleted.
+    qint64 m_snapshotBaseTimeMs = -1;
+    qint64 m_historyBaseTimeMs = -1;
+    qint64 m_prunedBelowMs = -1;
+};
+
+#endif
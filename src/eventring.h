@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. push() never blocks or allocates; it fails when the ring is full.
+template <typename T, std::size_t Capacity>
+class EventRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "EventRing capacity must be a power of two");
+
+public:
+    static constexpr std::size_t capacity() { return Capacity; }
+
+    // Producer side.
+    bool push(const T& item) {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail == Capacity) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail == Capacity) {
+                return false;
+            }
+        }
+        m_items[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Calls fn(const T&) for up to maxItems queued items in
+    // FIFO order and returns how many were consumed.
+    template <typename Fn>
+    std::size_t drain(Fn&& fn, std::size_t maxItems = Capacity) {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        std::size_t count = head - tail;
+        if (count > maxItems) {
+            count = maxItems;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(m_items[(tail + i) & (Capacity - 1)]);
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool isEmpty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t size() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    std::size_t m_cachedTail = 0;
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    alignas(64) T m_items[Capacity];
+};
+
+#endif
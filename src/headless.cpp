@@ -0,0 +1,656 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QTimer>
+#include <QThread>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QDebug>
+#include <QLoggingCategory>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMap>
+#include <QSet>
+#include "config.h"
+#include "inputdispatcher.h"
+#include "replaysource.h"
+#include "keylayout.h"
+#include "keystats.h"
+#include "keycounts.h"
+#include "eventlog.h"
+#include "httpserver.h"
+#include "jsonwriter.h"
+#include "metrics.h"
+#include "hubserver.h"
+#include "hubclient.h"
+#include "configwatcher.h"
+#include <atomic>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// User plus kernel CPU time of this process.
+static double processCpuSeconds() {
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto seconds = [](const FILETIME& time) {
+        return ((static_cast<quint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+// Serializes the /api/stats payload through the QJsonDocument path the
+// server used before and through JsonWriter, and prints throughput.
+static void benchmarkJson(const KeyStats& stats, int iterations, QTextStream& out) {
+    QElapsedTimer timer;
+    qint64 bytes = 0;
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        QJsonObject json;
+        json["totalKeyPresses"] = stats.totalKeyPresses();
+        json["kps"] = stats.kps();
+        json["kps1s"] = stats.kpsOver(KpsMeter::Window1s);
+        json["kps5s"] = stats.kpsOver(KpsMeter::Window5s);
+        json["peakKps"] = stats.peakKps();
+        QJsonObject keyCounts;
+        for (auto it = stats.keyCounts().constBegin(); it != stats.keyCounts().constEnd(); ++it) {
+            keyCounts[QString::number(it.key())] = it.value();
+        }
+        json["keyCounts"] = keyCounts;
+        // The old SSE path also went through QString before writing.
+        bytes += QString::fromUtf8(QJsonDocument(json).toJson(QJsonDocument::Compact)).toUtf8().size();
+    }
+    const double documentSeconds = timer.nsecsElapsed() / 1e9;
+    const qint64 documentBytes = bytes;
+
+    QByteArray buffer;
+    bytes = 0;
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        buffer.resize(0);
+        JsonWriter json(buffer);
+        json.beginObject();
+        json.key("totalKeyPresses").value(stats.totalKeyPresses());
+        json.key("kps").value(stats.kps());
+        json.key("kps1s").value(stats.kpsOver(KpsMeter::Window1s));
+        json.key("kps5s").value(stats.kpsOver(KpsMeter::Window5s));
+        json.key("peakKps").value(stats.peakKps());
+        json.key("keyCounts").beginObject();
+        for (auto it = stats.keyCounts().constBegin(); it != stats.keyCounts().constEnd(); ++it) {
+            json.key(it.key()).value(it.value());
+        }
+        json.endObject();
+        json.endObject();
+        bytes += buffer.size();
+    }
+    const double writerSeconds = timer.nsecsElapsed() / 1e9;
+
+    auto report = [&](const char* name, qint64 total, double seconds) {
+        out << name << ": " << total / iterations << " bytes/msg, "
+            << static_cast<qint64>(iterations / seconds) << " msg/s, "
+            << total / seconds / 1e6 << " MB/s" << Qt::endl;
+    };
+    out << stats.keyCounts().size() << " keys, " << iterations << " iterations" << Qt::endl;
+    report("QJsonDocument", documentBytes, documentSeconds);
+    report("JsonWriter   ", bytes, writerSeconds);
+}
+
+// Per-event cost of the key tables KeyStats updates on every press and
+// release: the QSet/QMap bookkeeping it used before against the VkBitmap
+// and KeyCounts tables, over the same pseudo-random sequence of the
+// layout's keys (or all vk codes without a layout).
+static void benchmarkKeyStats(const VkBitmap& layoutKeys, int events, QTextStream& out) {
+    std::vector<int> vkCodes;
+    for (int vk : layoutKeys) {
+        vkCodes.push_back(vk);
+    }
+    if (vkCodes.empty()) {
+        for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+            vkCodes.push_back(vk);
+        }
+    }
+    std::vector<int> sequence(static_cast<size_t>(events));
+    quint32 seed = 12345;
+    for (int& vk : sequence) {
+        seed = seed * 1103515245u + 12345u;
+        vk = vkCodes[(seed >> 16) % vkCodes.size()];
+    }
+    // Every third vk code is outside the layout, as keys the filter drops.
+    for (size_t i = 0; i < sequence.size(); i += 3) {
+        sequence[i] = (sequence[i] + 1) % VkBitmap::Size;
+    }
+
+    QElapsedTimer timer;
+    qint64 sum = 0;
+
+    QSet<int> validSet;
+    for (int vk : vkCodes) {
+        validSet.insert(vk);
+    }
+    QSet<int> pressedSet;
+    QMap<int, int> countMap;
+    timer.start();
+    for (int vk : sequence) {
+        if (!validSet.isEmpty() && !validSet.contains(vk)) continue;
+        pressedSet.insert(vk);
+        if (countMap.contains(vk)) {
+            countMap[vk]++;
+        } else {
+            countMap[vk] = 1;
+        }
+        sum += pressedSet.size();
+        pressedSet.remove(vk);
+    }
+    const qint64 setNs = timer.nsecsElapsed();
+    sum += countMap.size();
+
+    VkBitmap validBitmap;
+    for (int vk : vkCodes) {
+        validBitmap.insert(vk);
+    }
+    VkBitmap pressedBitmap;
+    KeyCounts counts;
+    timer.restart();
+    for (int vk : sequence) {
+        if (!validBitmap.isEmpty() && !validBitmap.contains(vk)) continue;
+        pressedBitmap.insert(vk);
+        counts.increment(vk);
+        sum += pressedBitmap.count();
+        pressedBitmap.remove(vk);
+    }
+    const qint64 bitmapNs = timer.nsecsElapsed();
+    sum += counts.size();
+
+    auto report = [&](const char* name, qint64 ns) {
+        out << name << ": " << static_cast<double>(ns) / events << " ns/event" << Qt::endl;
+    };
+    out << vkCodes.size() << " layout keys, " << events << " press/release pairs" << Qt::endl;
+    report("QSet+QMap       ", setNs);
+    report("VkBitmap+counts ", bitmapNs);
+    out << "(checksum " << sum << ")" << Qt::endl;
+}
+
+// Writes the keyboard array of the overlay page, as the server does.
+template <typename Keys>
+static int writeKeyboardJson(const Keys& keys, QByteArray& buffer) {
+    buffer.resize(0);
+    JsonWriter json(buffer);
+    json.beginArray();
+    for (const KeyInfo& info : keys) {
+        json.beginObject();
+        json.key("l").value(info.label);
+        json.key("vk").value(info.vkCode);
+        json.key("r").value(info.row);
+        json.key("c").value(info.col);
+        json.key("w").value(info.width);
+        json.endObject();
+    }
+    json.endArray();
+    return buffer.size();
+}
+
+// Builds a synthetic layout of keyCount keys (vk codes wrap around, so
+// large layouts bind several keys to one vk) and times the layout paths of
+// a frame: vk -> key lookups, the paint loop's dirty-rect scan and the
+// keyboard JSON, against the map from vk code to key the layout used to
+// be. That map is a QMultiMap here so both sides hold every key.
+static void benchmarkLayout(int keyCount, int iterations, QTextStream& out) {
+    QJsonArray keys;
+    for (int i = 0; i < keyCount; ++i) {
+        QJsonObject key;
+        key["vkCode"] = i % VkBitmap::Size;
+        key["label"] = QString::number(i);
+        key["row"] = i / 25;
+        key["col"] = i % 25;
+        keys.append(key);
+    }
+    QJsonObject root;
+    root["name"] = QString("synthetic-%1").arg(keyCount);
+    root["keys"] = keys;
+
+    QElapsedTimer timer;
+    timer.start();
+    KeyLayout layout;
+    layout.loadFromJson(root);
+    const qint64 loadNs = timer.nsecsElapsed();
+
+    QMultiMap<int, KeyInfo> map;
+    for (const KeyInfo& info : layout.keys()) {
+        map.insert(info.vkCode, info);
+    }
+
+    auto report = [&](const char* name, qint64 ns, qint64 ops) {
+        out << name << ": " << static_cast<double>(ns) / ops << " ns/op" << Qt::endl;
+    };
+    out << layout.keys().size() << " keys (" << map.uniqueKeys().size() << " distinct vk codes), load "
+        << loadNs / 1000 << " us, " << iterations << " iterations" << Qt::endl;
+
+    // Every vk once per iteration, as when a frame repaints all pressed keys.
+    qint64 sum = 0;
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+            for (int index : layout.keysFor(vk)) {
+                sum += layout.keys()[index].geometry.x();
+            }
+        }
+    }
+    report("lookup  vector+index", timer.nsecsElapsed(), qint64(iterations) * VkBitmap::Size);
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+            for (auto it = map.constFind(vk); it != map.constEnd() && it.key() == vk; ++it) {
+                sum += it.value().geometry.x();
+            }
+        }
+    }
+    report("lookup  QMap        ", timer.nsecsElapsed(), qint64(iterations) * VkBitmap::Size);
+
+    // paintEvent walks every key and tests it against the dirty rect.
+    const std::vector<KeyInfo>& layoutKeys = layout.keys();
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        const QRect dirty = layoutKeys[static_cast<size_t>(i) % layoutKeys.size()].geometry;
+        for (const KeyInfo& info : layoutKeys) {
+            sum += dirty.intersects(info.geometry) ? 1 : 0;
+        }
+    }
+    report("paint   vector      ", timer.nsecsElapsed(), iterations);
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        const QRect dirty = layoutKeys[static_cast<size_t>(i) % layoutKeys.size()].geometry;
+        for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+            sum += dirty.intersects(it.value().geometry) ? 1 : 0;
+        }
+    }
+    report("paint   QMap        ", timer.nsecsElapsed(), iterations);
+
+    QByteArray buffer;
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        sum += writeKeyboardJson(layoutKeys, buffer);
+    }
+    report("json    vector      ", timer.nsecsElapsed(), iterations);
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        sum += writeKeyboardJson(map, buffer);
+    }
+    report("json    QMap        ", timer.nsecsElapsed(), iterations);
+
+    // Switching layouts: parsing the JSON file against restoring the form
+    // kept in the layout cache. Each load logs, so debug output is muted.
+    const QByteArray source = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    const QByteArray compiled = layout.compiled();
+    const int loads = qMax(1, iterations / 100);
+    KeyLayout reloaded;
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false"));
+    timer.restart();
+    for (int i = 0; i < loads; ++i) {
+        sum += reloaded.loadFromData(source, QStringLiteral("synthetic")) ? 1 : 0;
+    }
+    report("switch  json        ", timer.nsecsElapsed(), loads);
+    timer.restart();
+    for (int i = 0; i < loads; ++i) {
+        sum += reloaded.loadCompiled(reinterpret_cast<const uchar*>(compiled.constData()), compiled.size()) ? 1 : 0;
+    }
+    report("switch  compiled    ", timer.nsecsElapsed(), loads);
+    QLoggingCategory::setFilterRules(QString());
+    out << "(checksum " << sum << ")" << Qt::endl;
+}
+
+// Load-test clients: opens SSE connections to the server from the thread it
+// is moved to, and counts the bytes and frames they receive.
+class SseLoad : public QObject {
+public:
+    SseLoad(quint16 port, int clients)
+        : m_port(port)
+        , m_clientCount(clients)
+    {
+    }
+
+    void open() {
+        for (int i = 0; i < m_clientCount; ++i) {
+            QTcpSocket* socket = new QTcpSocket(this);
+            connect(socket, &QTcpSocket::connected, this, [this, socket]() {
+                socket->write("GET /events HTTP/1.1\r\nHost: localhost\r\n\r\n");
+                m_connected.fetch_add(1, std::memory_order_relaxed);
+            });
+            connect(socket, &QTcpSocket::disconnected, this, [this]() {
+                m_connected.fetch_sub(1, std::memory_order_relaxed);
+            });
+            // Frames end with a blank line; one may straddle two reads.
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                const QByteArray data = socket->readAll();
+                quint64 frames = static_cast<quint64>(data.count("\n\n"));
+                const bool endsWithNewline = data.endsWith('\n');
+                if (socket->property("lf").toBool() && data.startsWith('\n')) {
+                    ++frames;
+                }
+                socket->setProperty("lf", endsWithNewline);
+                m_bytes.fetch_add(static_cast<quint64>(data.size()), std::memory_order_relaxed);
+                m_frames.fetch_add(frames, std::memory_order_relaxed);
+            });
+            socket->connectToHost(QHostAddress::LocalHost, m_port);
+        }
+    }
+
+    int connected() const { return m_connected.load(std::memory_order_relaxed); }
+    quint64 frames() const { return m_frames.load(std::memory_order_relaxed); }
+    quint64 bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+private:
+    quint16 m_port;
+    int m_clientCount;
+    std::atomic<int> m_connected{0};
+    std::atomic<quint64> m_frames{0};
+    std::atomic<quint64> m_bytes{0};
+};
+
+// Headless build of the stats and broadcast pipeline, fed by a ReplaySource
+// instead of the Win32 hooks. Used for load testing off Windows.
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("key-statics-headless");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("key-statics pipeline driven by a replay or synthetic input source");
+    parser.addHelpOption();
+    QCommandLineOption portOption({"p", "port"}, "HTTP server port (default: from config).", "port");
+    QCommandLineOption layoutOption({"l", "layout"}, "Layout JSON file.", "file");
+    QCommandLineOption replayOption("replay", "Replay a recorded event file instead of synthetic input.", "file");
+    QCommandLineOption keysOption("keys", "Comma-separated vk codes for synthetic input (default: 68,70,74,75).", "list");
+    QCommandLineOption rateOption({"r", "rate"}, "Events per second, 0 for unthrottled/recorded timing (default: 1000).", "rate", "1000");
+    QCommandLineOption countOption({"n", "count"}, "Stop after this many events (default: unlimited).", "count", "0");
+    QCommandLineOption loopOption("loop", "Loop the replay file.");
+    QCommandLineOption dropOption("drop", "Drop events when the ring is full instead of waiting.");
+    QCommandLineOption serveOption("serve", "Keep serving HTTP after the input stream ends.");
+    QCommandLineOption storageOption("storage", "Persist events and counters in this directory.", "dir");
+    QCommandLineOption benchJsonOption("bench-json", "Benchmark stats JSON serialization for every key of the layout and exit.", "iterations");
+    QCommandLineOption benchKeyStatsOption("bench-keystats", "Benchmark the per-event key table updates, old QSet/QMap against VkBitmap/KeyCounts, and exit.", "events");
+    QCommandLineOption benchLayoutOption("bench-layout", "Benchmark layout lookups, paint scan and keyboard JSON over a synthetic layout with this many keys and exit.", "keys");
+    QCommandLineOption measureIdleOption("measure-idle", "Serve without input for this many seconds, then print timer wakeups and CPU time.", "seconds");
+    QCommandLineOption sseClientsOption("sse-clients", "Open this many SSE clients against the server from a separate thread.", "count");
+    QCommandLineOption hubListenOption("hub-listen", "Aggregate hub nodes connecting on this port. Without --replay or --keys there is no local input.", "port");
+    QCommandLineOption hubBindOption("hub-bind", "Address the hub listens on (default: 127.0.0.1, no authentication).", "address");
+    QCommandLineOption hubConnectOption("hub-connect", "Forward input to the hub at host[:port].", "address");
+    QCommandLineOption hubNameOption("hub-name", "Source name reported to the hub (default: from config).", "name");
+    QCommandLineOption watchOption("watch", "Reload config.json and the layout when they change on disk.");
+    parser.addOptions({portOption, layoutOption, replayOption, keysOption, rateOption,
+                       countOption, loopOption, dropOption, serveOption, storageOption, benchJsonOption,
+                       benchKeyStatsOption, benchLayoutOption, measureIdleOption, sseClientsOption, hubListenOption, hubBindOption, hubConnectOption, hubNameOption,
+                       watchOption});
+    parser.process(app);
+
+    Config::instance()->load();
+    quint16 port = parser.isSet(portOption)
+        ? static_cast<quint16>(parser.value(portOption).toUInt())
+        : Config::instance()->serverPort();
+
+    QString layoutPath = parser.value(layoutOption);
+    if (layoutPath.isEmpty()) {
+        layoutPath = QCoreApplication::applicationDirPath() + "/layouts/"
+            + Config::instance()->defaultLayout() + ".json";
+    }
+
+    KeyLayout layout;
+    KeyStats stats;
+    stats.setChordWindow(Config::instance()->chordWindowMs());
+    if (QFileInfo::exists(layoutPath) && layout.loadFromCache(layoutPath)) {
+        stats.setValidKeys(layout.vkCodes());
+    }
+
+    QTextStream out(stdout);
+
+    if (parser.isSet(benchJsonOption)) {
+        int presses = 1;
+        for (int vk : layout.vkCodes()) {
+            for (int i = 0; i < presses; ++i) {
+                stats.recordKeyPress(vk);
+                stats.recordKeyRelease(vk);
+            }
+            presses = presses * 7 % 997;
+        }
+        benchmarkJson(stats, qMax(1, parser.value(benchJsonOption).toInt()), out);
+        return 0;
+    }
+
+    if (parser.isSet(benchKeyStatsOption)) {
+        benchmarkKeyStats(layout.vkCodes(), qMax(1, parser.value(benchKeyStatsOption).toInt()), out);
+        return 0;
+    }
+
+    if (parser.isSet(benchLayoutOption)) {
+        benchmarkLayout(qMax(1, parser.value(benchLayoutOption).toInt()), 10000, out);
+        return 0;
+    }
+
+    EventLog eventLog;
+    if (parser.isSet(storageOption)) {
+        EventLog::RestoredCounts restored;
+        if (!eventLog.open(parser.value(storageOption), &restored, &stats.history())) {
+            return 1;
+        }
+        stats.restore(restored.counts, restored.totalKeyPresses);
+        eventLog.setStats(&stats);
+        stats.setEventLog(&eventLog);
+    }
+
+    InputDispatcher dispatcher;
+    QObject::connect(&dispatcher, &InputDispatcher::keyPressed, &stats, &KeyStats::recordKeyPress);
+    QObject::connect(&dispatcher, &InputDispatcher::keyReleased, &stats, &KeyStats::recordKeyRelease);
+    QObject::connect(&dispatcher, &InputDispatcher::buttonPressed, &stats, &KeyStats::recordKeyPress);
+    QObject::connect(&dispatcher, &InputDispatcher::buttonReleased, &stats, &KeyStats::recordKeyRelease);
+
+    HttpServer server(&stats);
+    server.setLayout(&layout);
+
+    HubServer hubServer(&stats);
+    if (parser.isSet(hubListenOption)) {
+        const QHostAddress address(parser.isSet(hubBindOption) ? parser.value(hubBindOption) : QString("127.0.0.1"));
+        if (!hubServer.listen(static_cast<quint16>(parser.value(hubListenOption).toUInt()), address)) {
+            return 1;
+        }
+        server.setHub(&hubServer);
+    }
+
+    HubClient hubClient;
+    if (parser.isSet(hubConnectOption)) {
+        hubClient.setName(parser.isSet(hubNameOption) ? parser.value(hubNameOption)
+                                                      : Config::instance()->hubName());
+        if (!hubClient.connectToHub(parser.value(hubConnectOption))) {
+            return 1;
+        }
+        QObject::connect(&dispatcher, &InputDispatcher::keyPressed, &hubClient, [&](int vk) {
+            hubClient.record(vk, InputEvent::Press, InputEvent::Keyboard);
+        });
+        QObject::connect(&dispatcher, &InputDispatcher::keyReleased, &hubClient, [&](int vk) {
+            hubClient.record(vk, InputEvent::Release, InputEvent::Keyboard);
+        });
+        QObject::connect(&dispatcher, &InputDispatcher::buttonPressed, &hubClient, [&](int vk) {
+            hubClient.record(vk, InputEvent::Press, InputEvent::Mouse);
+        });
+        QObject::connect(&dispatcher, &InputDispatcher::buttonReleased, &hubClient, [&](int vk) {
+            hubClient.record(vk, InputEvent::Release, InputEvent::Mouse);
+        });
+    }
+
+    if (parser.isSet(watchOption)) {
+        // A file that fails to parse leaves the loaded layout untouched.
+        auto* watcher = new ConfigWatcher(QCoreApplication::applicationDirPath() + "/config.json",
+                                          QFileInfo(layoutPath).absolutePath(), &app);
+        QObject::connect(watcher, &ConfigWatcher::configChanged, &app, [&](const QString& file) {
+            Config::instance()->load(file);
+            stats.setChordWindow(Config::instance()->chordWindowMs());
+        });
+        QObject::connect(watcher, &ConfigWatcher::layoutChanged, &app, [&](const QString& file) {
+            if (QFileInfo(file) == QFileInfo(layoutPath) && layout.loadFromCache(file)) {
+                stats.setValidKeys(layout.vkCodes());
+                server.setLayout(&layout);
+                out << "layout reloaded: " << layout.keys().size() << " keys" << Qt::endl;
+            }
+        });
+    }
+
+    if (!server.start(port)) {
+        return 1;
+    }
+
+    if (parser.isSet(hubListenOption) && !parser.isSet(replayOption) && !parser.isSet(keysOption)) {
+        // Pure aggregator: everything comes from the nodes.
+        QTimer hubReport;
+        QObject::connect(&hubReport, &QTimer::timeout, &app, [&]() {
+            out << "sources=" << hubServer.connectedSources() << "/" << hubServer.sources().size()
+                << " received=" << Metrics::instance()->value(Metrics::HubEventsReceived)
+                << " presses=" << stats.totalKeyPresses()
+                << " kps=" << stats.kps() << Qt::endl;
+        });
+        hubReport.start(1000);
+        const int result = app.exec();
+        eventLog.close();
+        return result;
+    }
+
+    if (parser.isSet(measureIdleOption)) {
+        // A few presses first, so the window includes the KPS decay.
+        for (int vk : {68, 70, 74, 75}) {
+            stats.recordKeyPress(vk);
+            stats.recordKeyRelease(vk);
+        }
+        const int seconds = qMax(1, parser.value(measureIdleOption).toInt());
+        const quint64 wakeups = Metrics::instance()->value(Metrics::TimerWakeups);
+        const double cpuSeconds = processCpuSeconds();
+        QTimer::singleShot(seconds * 1000, &app, [&, seconds, wakeups, cpuSeconds]() {
+            const quint64 count = Metrics::instance()->value(Metrics::TimerWakeups) - wakeups;
+            const double cpuMs = (processCpuSeconds() - cpuSeconds) * 1000;
+            out << "idle " << seconds << " s: " << count << " timer wakeups ("
+                << static_cast<double>(count) / seconds << "/s), " << cpuMs << " ms CPU ("
+                << cpuMs / (seconds * 10.0) << "%)" << Qt::endl;
+            app.quit();
+        });
+        const int result = app.exec();
+        eventLog.close();
+        return result;
+    }
+
+    ReplaySource source;
+    source.setDispatcher(&dispatcher);
+    source.setRate(parser.value(rateOption).toDouble());
+    source.setEventLimit(parser.value(countOption).toULongLong());
+    source.setLoop(parser.isSet(loopOption));
+    source.setBlocking(!parser.isSet(dropOption));
+
+    if (parser.isSet(replayOption)) {
+        if (!source.loadFile(parser.value(replayOption))) {
+            return 1;
+        }
+    } else if (parser.isSet(keysOption)) {
+        QList<int> keys;
+        for (const QString& key : parser.value(keysOption).split(',', Qt::SkipEmptyParts)) {
+            keys.append(key.trimmed().toInt());
+        }
+        source.setSyntheticKeys(keys);
+    }
+
+    // The load clients run on a thread of their own so they compete with
+    // the server thread rather than with input handling.
+    QThread loadThread;
+    SseLoad* load = nullptr;
+    if (parser.isSet(sseClientsOption)) {
+        load = new SseLoad(port, qMax(1, parser.value(sseClientsOption).toInt()));
+        load->moveToThread(&loadThread);
+        QObject::connect(&loadThread, &QThread::started, load, [load]() { load->open(); });
+        QObject::connect(&loadThread, &QThread::finished, load, &QObject::deleteLater);
+        loadThread.start();
+    }
+
+    QElapsedTimer elapsed;
+    quint64 lastProduced = 0;
+    quint64 lastFrames = 0;
+
+    auto report = [&]() {
+        quint64 produced = source.eventsProduced();
+        out << "events=" << produced
+            << " rate=" << (produced - lastProduced) << "/s"
+            << " presses=" << stats.totalKeyPresses()
+            << " kps=" << stats.kps()
+            << " dropped=" << dispatcher.droppedEvents();
+        if (parser.isSet(hubConnectOption)) {
+            out << " hub=" << (hubClient.isConnected() ? "up" : "down")
+                << " sent=" << hubClient.eventsSent()
+                << " unsent=" << hubClient.eventsDropped();
+        }
+        if (load) {
+            const quint64 frames = load->frames();
+            out << " sse=" << load->connected()
+                << " frames=" << (frames - lastFrames) << "/s"
+                << " bytes=" << load->bytes();
+            lastFrames = frames;
+        }
+        out << Qt::endl;
+        lastProduced = produced;
+    };
+
+    QTimer reportTimer;
+    QObject::connect(&reportTimer, &QTimer::timeout, &app, report);
+    reportTimer.start(1000);
+
+    QObject::connect(&source, &ReplaySource::finished, &app, [&]() {
+        while (dispatcher.pendingEvents() > 0) {
+            dispatcher.drain();
+        }
+        double seconds = elapsed.nsecsElapsed() / 1e9;
+        quint64 produced = source.eventsProduced();
+        out << "finished: " << produced << " events in " << seconds << " s ("
+            << static_cast<quint64>(seconds > 0 ? produced / seconds : 0) << " events/s), "
+            << dispatcher.droppedEvents() << " dropped" << Qt::endl;
+        if (!parser.isSet(serveOption)) {
+            app.quit();
+        }
+    });
+
+    elapsed.start();
+    if (!source.start()) {
+        return 1;
+    }
+
+    int result = app.exec();
+    source.stop();
+    loadThread.quit();
+    loadThread.wait();
+    eventLog.close();
+    return result;
+}
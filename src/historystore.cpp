@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "historystore.h"
+#include <QVarLengthArray>
+#include <iterator>
+
+namespace {
+
+const quint32 HistoryMagic = 0x4B534853;  // "KSHS"
+const quint32 HistoryVersion = 1;
+
+}
+
+HistoryStore::HistoryStore() {
+    initLevel(m_levels[Seconds], 1000, 3600, false);
+    initLevel(m_levels[Minutes], 60 * 1000, 1440, true);
+    initLevel(m_levels[Hours], 60 * 60 * 1000, 720, true);
+}
+
+void HistoryStore::initLevel(Level& level, qint64 bucketMs, int slotCount, bool perKey) {
+    level.bucketMs = bucketMs;
+    level.slotCount = slotCount;
+    level.perKey = perKey;
+    level.tags.fill(-1, slotCount);
+    level.totals.fill(0, slotCount);
+    for (QVector<quint32>& column : level.keys) {
+        column.clear();
+    }
+}
+
+// Returns the slot for the bucket, clearing it first if it still holds an
+// older bucket from a previous turn of the ring.
+int HistoryStore::claimSlot(Level& level, qint64 bucket) {
+    const int slot = static_cast<int>(bucket % level.slotCount);
+    if (level.tags[slot] != bucket) {
+        level.tags[slot] = bucket;
+        level.totals[slot] = 0;
+        if (level.perKey) {
+            for (QVector<quint32>& column : level.keys) {
+                if (!column.isEmpty()) {
+                    column[slot] = 0;
+                }
+            }
+        }
+    }
+    return slot;
+}
+
+void HistoryStore::record(qint64 timeMs, int vkCode) {
+    if (timeMs < 0 || !VkBitmap::isValid(vkCode)) return;
+
+    for (Level& level : m_levels) {
+        const int slot = claimSlot(level, timeMs / level.bucketMs);
+        ++level.totals[slot];
+        if (level.perKey) {
+            QVector<quint32>& column = level.keys[vkCode];
+            if (column.isEmpty()) {
+                column.fill(0, level.slotCount);
+            }
+            ++column[slot];
+        }
+    }
+}
+
+bool HistoryStore::query(const Query& query, Series& series) const {
+    qint64 stepMs = qMax<qint64>(query.stepMs, m_levels[query.perKey ? Minutes : Seconds].bucketMs);
+
+    // The coarsest level whose buckets tile the step.
+    const Level* level = nullptr;
+    for (int r = ResolutionCount - 1; r >= 0; --r) {
+        const Level& candidate = m_levels[r];
+        if ((query.perKey && !candidate.perKey) || candidate.bucketMs > stepMs) continue;
+        if (stepMs % candidate.bucketMs == 0) {
+            level = &candidate;
+            break;
+        }
+    }
+    if (!level) {
+        // Steps that are not a whole number of seconds round up to one.
+        level = &m_levels[query.perKey ? Minutes : Seconds];
+        stepMs = (stepMs + level->bucketMs - 1) / level->bucketMs * level->bucketMs;
+    }
+
+    // A level only holds its last slotCount buckets. If the range starts
+    // before that, move up to the first coarser level that still holds it
+    // (rounding the step up to its buckets); beyond the coarsest level's
+    // retention nothing is kept, and those bins read as zero.
+    const qint64 nowMs = query.nowMs > 0 ? query.nowMs : query.toMs;
+    auto holds = [&](const Level& candidate) {
+        const qint64 fromBucket = qMax<qint64>(0, query.fromMs) / stepMs * stepMs / candidate.bucketMs;
+        return fromBucket > nowMs / candidate.bucketMs - candidate.slotCount;
+    };
+    while (!holds(*level) && level != &m_levels[ResolutionCount - 1]) {
+        ++level;
+        stepMs = (stepMs + level->bucketMs - 1) / level->bucketMs * level->bucketMs;
+    }
+
+    const qint64 fromMs = qMax<qint64>(0, query.fromMs) / stepMs * stepMs;
+    if (query.toMs <= fromMs) return false;
+    const qint64 bins = (query.toMs - fromMs + stepMs - 1) / stepMs;
+    if (bins > MaxBins) return false;
+
+    series.fromMs = fromMs;
+    series.stepMs = stepMs;
+    series.resolutionMs = level->bucketMs;
+    series.totals.fill(0, static_cast<int>(bins));
+    series.keys.clear();
+
+    struct KeyColumn {
+        const QVector<quint32>* source;
+        QVector<quint32>* target;
+    };
+    QVarLengthArray<KeyColumn, VkBitmap::Size> keyColumns;
+    if (query.perKey) {
+        for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+            if (!level->keys[vk].isEmpty()) {
+                QVector<quint32>& column = series.keys[vk];
+                column.fill(0, static_cast<int>(bins));
+                keyColumns.append({ &level->keys[vk], &column });
+            }
+        }
+    }
+
+    const qint64 bucketsPerBin = stepMs / level->bucketMs;
+    qint64 bucket = fromMs / level->bucketMs;
+    for (int bin = 0; bin < bins; ++bin) {
+        for (qint64 i = 0; i < bucketsPerBin; ++i, ++bucket) {
+            const int slot = static_cast<int>(bucket % level->slotCount);
+            if (level->tags[slot] != bucket) continue;
+            series.totals[bin] += level->totals[slot];
+            for (const KeyColumn& column : keyColumns) {
+                (*column.target)[bin] += (*column.source)[slot];
+            }
+        }
+    }
+
+    // Drop keys that had no presses in the range.
+    for (auto it = series.keys.begin(); it != series.keys.end();) {
+        bool any = false;
+        for (quint32 value : it.value()) {
+            if (value) {
+                any = true;
+                break;
+            }
+        }
+        it = any ? std::next(it) : series.keys.erase(it);
+    }
+    return true;
+}
+
+void HistoryStore::save(QDataStream& out) const {
+    out << HistoryMagic << HistoryVersion;
+    for (const Level& level : m_levels) {
+        out << level.bucketMs << static_cast<qint32>(level.slotCount) << level.tags << level.totals;
+        qint32 columns = 0;
+        for (const QVector<quint32>& column : level.keys) {
+            columns += column.isEmpty() ? 0 : 1;
+        }
+        out << columns;
+        for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+            if (!level.keys[vk].isEmpty()) {
+                out << static_cast<qint32>(vk) << level.keys[vk];
+            }
+        }
+    }
+}
+
+bool HistoryStore::load(QDataStream& in) {
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != HistoryMagic || version != HistoryVersion) {
+        return false;
+    }
+
+    HistoryStore loaded;
+    for (Level& level : loaded.m_levels) {
+        qint64 bucketMs = 0;
+        qint32 slotCount = 0, columns = 0;
+        QVector<qint64> tags;
+        QVector<quint32> totals;
+        in >> bucketMs >> slotCount >> tags >> totals >> columns;
+        if (bucketMs != level.bucketMs || slotCount != level.slotCount
+            || tags.size() != slotCount || totals.size() != slotCount) {
+            return false;
+        }
+        level.tags = tags;
+        level.totals = totals;
+        for (qint32 c = 0; c < columns; ++c) {
+            qint32 vk = -1;
+            QVector<quint32> column;
+            in >> vk >> column;
+            if (!VkBitmap::isValid(vk) || column.size() != slotCount) {
+                return false;
+            }
+            level.keys[vk] = column;
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    *this = loaded;
+    return true;
+}
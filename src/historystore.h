@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QMap>
+#include <QDataStream>
+#include "vkbitmap.h"
+
+// Press counts rolled up into wall-clock buckets at three resolutions:
+//   1 s buckets for the last hour (totals only)
+//   1 min buckets for the last day (totals and per-key)
+//   1 h buckets for the last 30 days (totals and per-key)
+// Each level is a ring of slots tagged with the bucket number they hold,
+// stored column-wise: one totals column plus one column per key that has
+// been pressed. Range queries read whole buckets from the coarsest level
+// that fits the requested step, or from a coarser one if that level no
+// longer holds the start of the range, and never look at raw events.
+class HistoryStore {
+public:
+    enum Resolution {
+        Seconds,
+        Minutes,
+        Hours,
+        ResolutionCount
+    };
+
+    struct Query {
+        qint64 fromMs = 0;
+        qint64 toMs = 0;
+        qint64 stepMs = 60000;
+        bool perKey = false;
+        // Retention is counted back from here; 0 means toMs.
+        qint64 nowMs = 0;
+    };
+
+    struct Series {
+        qint64 fromMs = 0;          // aligned down to the step
+        qint64 stepMs = 0;
+        qint64 resolutionMs = 0;    // bucket size the answer was built from
+        QVector<quint32> totals;
+        QMap<int, QVector<quint32>> keys;
+    };
+
+    static constexpr int MaxBins = 10000;
+
+    HistoryStore();
+
+    void record(qint64 timeMs, int vkCode);
+
+    // Returns false if the range is empty or needs more than MaxBins bins.
+    bool query(const Query& query, Series& series) const;
+
+    // Serialized form, embedded by EventLog next to its counter snapshot.
+    void save(QDataStream& out) const;
+    bool load(QDataStream& in);
+
+private:
+    struct Level {
+        qint64 bucketMs = 0;
+        int slotCount = 0;
+        bool perKey = false;
+        QVector<qint64> tags;       // bucket number held by each slot, -1 if empty
+        QVector<quint32> totals;
+        QVector<quint32> keys[VkBitmap::Size];  // empty until the key is pressed
+    };
+
+    static void initLevel(Level& level, qint64 bucketMs, int slotCount, bool perKey);
+    static int claimSlot(Level& level, qint64 bucket);
+
+    Level m_levels[ResolutionCount];
+};
+
+#endif
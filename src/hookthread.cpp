@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "hookthread.h"
+#include "keyboardhook.h"
+#include "mousehook.h"
+#include <QDebug>
+
+HookThread::HookThread(InputDispatcher* dispatcher, QObject* parent)
+    : QThread(parent)
+    , m_dispatcher(dispatcher)
+{
+    setObjectName("HookThread");
+}
+
+HookThread::~HookThread() {
+    stop();
+}
+
+void HookThread::stop() {
+    if (isRunning()) {
+        quit();
+        wait();
+    }
+}
+
+void HookThread::run() {
+    // Both hooks live on this thread, so it is the single producer of the
+    // dispatcher's ring.
+    KeyboardHook keyboardHook;
+    keyboardHook.setDispatcher(m_dispatcher);
+    if (!keyboardHook.start()) {
+        qWarning() << "Failed to start keyboard hook!";
+    }
+
+    MouseHook mouseHook;
+    mouseHook.setDispatcher(m_dispatcher);
+    if (!mouseHook.start()) {
+        qWarning() << "Failed to start mouse hook!";
+    }
+
+    exec();
+
+    keyboardHook.stop();
+    mouseHook.stop();
+}
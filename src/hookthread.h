@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HOOKTHREAD_H
+#define HOOKTHREAD_H
+
+#include <QThread>
+#include "inputdispatcher.h"
+
+// Installs the low-level keyboard and mouse hooks on a dedicated thread with
+// its own message loop, so hook callbacks never wait on the GUI thread.
+class HookThread : public QThread {
+    Q_OBJECT
+
+public:
+    explicit HookThread(InputDispatcher* dispatcher, QObject* parent = nullptr);
+    ~HookThread();
+
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    InputDispatcher* m_dispatcher = nullptr;
+};
+
+#endif
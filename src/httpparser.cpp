@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "httpparser.h"
+
+QByteArray HttpRequest::header(const QByteArray& name) const {
+    for (const auto& header : headers) {
+        if (header.first == name) {
+            return header.second;
+        }
+    }
+    return QByteArray();
+}
+
+QByteArray HttpRequest::queryValue(const QByteArray& name) const {
+    int pos = 0;
+    while (pos <= query.size()) {
+        int end = query.indexOf('&', pos);
+        if (end < 0) {
+            end = query.size();
+        }
+        int eq = query.indexOf('=', pos);
+        if (eq > pos && eq < end && query.mid(pos, eq - pos) == name) {
+            return QByteArray::fromPercentEncoding(query.mid(eq + 1, end - eq - 1));
+        }
+        pos = end + 1;
+    }
+    return QByteArray();
+}
+
+bool HttpRequest::keepAlive() const {
+    QByteArray connection = header("connection").toLower();
+    if (version == "HTTP/1.0") {
+        return connection.contains("keep-alive");
+    }
+    return !connection.contains("close");
+}
+
+void HttpRequestParser::append(const QByteArray& data) {
+    if (m_errorStatus != 0) {
+        return;
+    }
+    if (m_buffer.size() - m_readOffset + data.size() > MaxBufferedSize) {
+        fail(413);
+        return;
+    }
+    m_buffer.append(data);
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(int status) {
+    m_errorStatus = status;
+    return Error;
+}
+
+void HttpRequestParser::consume(int end) {
+    m_readOffset = end;
+    m_scanOffset = end;
+    if (m_readOffset == m_buffer.size()) {
+        m_buffer.clear();
+        m_readOffset = 0;
+        m_scanOffset = 0;
+    } else if (m_readOffset > MaxHeaderSize) {
+        m_buffer.remove(0, m_readOffset);
+        m_readOffset = 0;
+        m_scanOffset = 0;
+    }
+}
+
+QByteArray HttpRequestParser::takeBuffered() {
+    QByteArray rest = m_buffer.mid(m_readOffset);
+    m_buffer.clear();
+    m_readOffset = 0;
+    m_scanOffset = 0;
+    return rest;
+}
+
+HttpRequestParser::Status HttpRequestParser::next(HttpRequest& request) {
+    if (m_errorStatus != 0) {
+        return Error;
+    }
+
+    // Tolerate empty lines between pipelined requests.
+    while (m_buffer.size() - m_readOffset >= 2 && m_buffer.at(m_readOffset) == '\r'
+           && m_buffer.at(m_readOffset + 1) == '\n') {
+        consume(m_readOffset + 2);
+    }
+
+    const int start = m_readOffset;
+    const int headerEnd = m_buffer.indexOf("\r\n\r\n", qMax(start, m_scanOffset));
+    if (headerEnd < 0) {
+        if (m_buffer.size() - start > MaxHeaderSize) {
+            return fail(431);
+        }
+        // Resume the search where it stopped, allowing for a split "\r\n\r\n".
+        m_scanOffset = qMax(start, m_buffer.size() - 3);
+        return NeedMoreData;
+    }
+    if (headerEnd - start > MaxHeaderSize) {
+        return fail(431);
+    }
+
+    int lineEnd = m_buffer.indexOf("\r\n", start);
+    const QByteArray requestLine = m_buffer.mid(start, lineEnd - start);
+    const int firstSpace = requestLine.indexOf(' ');
+    const int secondSpace = requestLine.indexOf(' ', firstSpace + 1);
+    if (firstSpace <= 0 || secondSpace <= firstSpace + 1) {
+        return fail(400);
+    }
+
+    request = HttpRequest();
+    request.method = requestLine.left(firstSpace);
+    request.version = requestLine.mid(secondSpace + 1);
+    if (!request.version.startsWith("HTTP/1.")) {
+        return fail(400);
+    }
+    const QByteArray target = requestLine.mid(firstSpace + 1, secondSpace - firstSpace - 1);
+    const int question = target.indexOf('?');
+    request.path = question < 0 ? target : target.left(question);
+    request.query = question < 0 ? QByteArray() : target.mid(question + 1);
+
+    int contentLength = 0;
+    int pos = lineEnd + 2;
+    while (pos < headerEnd + 2) {
+        lineEnd = m_buffer.indexOf("\r\n", pos);
+        const int colon = m_buffer.indexOf(':', pos);
+        if (colon <= pos || colon > lineEnd) {
+            return fail(400);
+        }
+        QByteArray name = m_buffer.mid(pos, colon - pos).toLower();
+        QByteArray value = m_buffer.mid(colon + 1, lineEnd - colon - 1).trimmed();
+        if (name == "content-length") {
+            bool ok = false;
+            contentLength = value.toInt(&ok);
+            if (!ok || contentLength < 0) {
+                return fail(400);
+            }
+            if (contentLength > MaxBodySize) {
+                return fail(413);
+            }
+        } else if (name == "transfer-encoding") {
+            return fail(501);
+        }
+        request.headers.append(qMakePair(name, value));
+        pos = lineEnd + 2;
+    }
+
+    const int bodyStart = headerEnd + 4;
+    if (m_buffer.size() - bodyStart < contentLength) {
+        // Headers are parsed again once the body is complete.
+        m_scanOffset = start;
+        return NeedMoreData;
+    }
+
+    request.body = m_buffer.mid(bodyStart, contentLength);
+    consume(bodyStart + contentLength);
+    return RequestReady;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HTTPPARSER_H
+#define HTTPPARSER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+struct HttpRequest {
+    QByteArray method;
+    QByteArray path;
+    QByteArray query;
+    QByteArray version;
+    QList<QPair<QByteArray, QByteArray>> headers;  // names are lower-case
+    QByteArray body;
+
+    QByteArray header(const QByteArray& name) const;
+    QByteArray queryValue(const QByteArray& name) const;
+    bool keepAlive() const;
+};
+
+// Incremental HTTP/1.x request parser for one connection. Bytes are
+// appended as they arrive; next() yields complete requests in order, so
+// requests split across segments and pipelined requests both work. The
+// buffer is scanned in place and only consumed bytes are discarded.
+class HttpRequestParser {
+public:
+    enum Status {
+        NeedMoreData,
+        RequestReady,
+        Error
+    };
+
+    static constexpr int MaxHeaderSize = 8 * 1024;
+    static constexpr int MaxBodySize = 64 * 1024;
+    // Unparsed bytes held at most, also while next() is not being called,
+    // e.g. when a client pipelines behind a request still being answered.
+    static constexpr int MaxBufferedSize = MaxHeaderSize + MaxBodySize;
+
+    // Fails with 413 once more than MaxBufferedSize bytes are unparsed.
+    void append(const QByteArray& data);
+    Status next(HttpRequest& request);
+
+    // HTTP status to answer with after next() returned Error.
+    int errorStatus() const { return m_errorStatus; }
+
+    // Unparsed bytes, e.g. WebSocket frames that followed an upgrade request.
+    QByteArray takeBuffered();
+
+private:
+    Status fail(int status);
+    void consume(int end);
+
+    QByteArray m_buffer;
+    int m_readOffset = 0;
+    int m_scanOffset = 0;
+    int m_errorStatus = 0;
+};
+
+#endif
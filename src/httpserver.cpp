@@ -16,61 +16,176 @@
  */
 #include "httpserver.h"
 #include "config.h"
+#include "websocket.h"
+#include "jsonwriter.h"
+#include "latency.h"
+#include "metrics.h"
 #include <QDebug>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QTimer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <array>
 
-QList<QTcpSocket*> sseClients;
-
-HttpServer::HttpServer(KeyStats* stats, QObject* parent)
-    : QObject(parent)
-    , m_stats(stats)
+HttpServer::HttpServer(KeyStats* stats)
+    : m_stats(stats)
 {
-    m_server = new QTcpServer(this);
-    connect(m_server, &QTcpServer::newConnection, this, &HttpServer::onNewConnection);
-    
-    QTimer* timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &HttpServer::broadcastSse);
-    timer->start(16);
+    m_broadcastTimer = new QTimer(this);
+    m_broadcastTimer->setSingleShot(true);
+    connect(m_broadcastTimer, &QTimer::timeout, this, [this]() {
+        Metrics::instance()->add(Metrics::TimerWakeups);
+        broadcast();
+    });
+
+    // Armed by the first delta after a keyframe, so idle clients cost no
+    // wakeups: without deltas they cannot have drifted.
+    m_keyframeTimer = new QTimer(this);
+    m_keyframeTimer->setSingleShot(true);
+    m_keyframeTimer->setInterval(KeyframeIntervalMs);
+    connect(m_keyframeTimer, &QTimer::timeout, this, [this]() {
+        Metrics::instance()->add(Metrics::TimerWakeups);
+        m_keyframeDue = true;
+        broadcast();
+    });
+
+    m_lastBroadcast.start();
+
+    // Versions restart with the process; the epoch keeps ETags from a
+    // previous run from matching.
+    m_etagEpoch = QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 36);
+
+    if (m_stats) {
+        connect(m_stats, &KeyStats::snapshotPublished, this, &HttpServer::scheduleBroadcast);
+    }
+
+    // The page reads the layout and config, which belong to the GUI
+    // thread, so it is rendered there and handed over.
+    m_page = buildPage();
+    m_configConnection = connect(Config::instance(), &Config::changed, Config::instance(),
+                                 [this]() { publishPage(ReloadEvent); });
+
+    m_thread = new QThread;
+    m_thread->setObjectName("HttpServer");
+    moveToThread(m_thread);
 }
 
 HttpServer::~HttpServer() {
+    disconnect(m_configConnection);
     stop();
+    delete m_thread;
 }
 
 void HttpServer::setLayout(KeyLayout* layout) {
     m_layout = layout;
+    publishPage(LayoutEvent);
 }
 
-QString HttpServer::generateKeyboardJson() const {
-    if (!m_layout) return "[]";
-    
-    QStringList keyList;
-    const QMap<int, KeyInfo>& keys = m_layout->keys();
-    for (auto it = keys.constBegin(); it != keys.constEnd(); ++it) {
-        const KeyInfo& info = it.value();
-        QString label = info.label;
-        label.replace("\\", "\\\\");
-        label.replace("'", "\\'");
-        QString keyStr = QString("{l:'%1',vk:%2,r:%3,c:%4,w:%5")
-            .arg(label)
-            .arg(info.vkCode)
-            .arg(info.row)
-            .arg(info.col)
-            .arg(info.width);
-        if (info.height > 1) {
-            keyStr += ",h:" + QString::number(info.height);
-        }
-        keyStr += "}";
-        keyList.append(keyStr);
-    }
-    return "[" + keyList.join(",") + "]";
+void HttpServer::publishPage(PageEvent event) {
+    const CachedPage page = buildPage();
+    QMetaObject::invokeMethod(this, [this, page, event]() {
+        m_page = page;
+        pushPageEvent(event);
+    }, Qt::QueuedConnection);
+}
+
+// Page events bypass the backpressure checks: they are rare and small, and
+// a client that missed one would keep showing the old layout.
+void HttpServer::pushPageEvent(PageEvent event) {
+    if (!hasPushClients()) return;
+
+    QByteArray sse;
+    QByteArray ws;
+    if (event == LayoutEvent) {
+        sse = "event: layout\ndata: " + m_page.layoutJson + "\n\n";
+        ws = "{\"event\":\"layout\",\"layout\":" + m_page.layoutJson + "}";
+    } else {
+        sse = "event: reload\ndata: {}\n\n";
+        ws = "{\"event\":\"reload\"}";
+    }
+    for (QTcpSocket* client : m_sseClients) {
+        writeToClient(client, sse);
+    }
+    if (!m_wsClients.isEmpty()) {
+        const QByteArray frame = WebSocket::encodeFrame(WebSocket::Text, ws);
+        for (auto it = m_wsClients.constBegin(); it != m_wsClients.constEnd(); ++it) {
+            writeToClient(it.key(), frame);
+        }
+    }
+}
+
+QByteArray HttpServer::generateKeyboardJson() const {
+    QByteArray out;
+    JsonWriter json(out);
+    writeKeyboard(json);
+    return out;
+}
+
+void HttpServer::writeKeyboard(JsonWriter& json) const {
+    json.beginArray();
+    if (m_layout) {
+        for (const KeyInfo& info : m_layout->keys()) {
+            json.beginObject();
+            json.key("l").value(info.label);
+            json.key("vk").value(info.vkCode);
+            json.key("r").value(info.row);
+            json.key("c").value(info.col);
+            json.key("w").value(info.width);
+            if (info.height > 1) {
+                json.key("h").value(info.height);
+            }
+            json.endObject();
+        }
+    }
+    json.endArray();
+}
+
+// {"name", "unitWidth", "unitHeight", "keySpacing", "keys"}: what the
+// overlay needs to rebuild its keyboard.
+QByteArray HttpServer::generateLayoutJson() const {
+    Config* config = Config::instance();
+    QByteArray out;
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("name").value(m_layout ? m_layout->name() : QString());
+    json.key("unitWidth").value(config->unitWidth());
+    json.key("unitHeight").value(config->unitHeight());
+    json.key("keySpacing").value(config->keySpacing());
+    json.key("keys");
+    writeKeyboard(json);
+    json.endObject();
+    return out;
 }
 
 bool HttpServer::start(quint16 port) {
     m_port = port;
+    // After stop() the object is back on this thread.
+    if (thread() == QThread::currentThread()) {
+        moveToThread(m_thread);
+    }
+    if (!m_thread->isRunning()) {
+        m_thread->start();
+    }
+    bool listening = false;
+    QMetaObject::invokeMethod(this, [this, &listening]() { listening = listen(); },
+                              Qt::BlockingQueuedConnection);
+    return listening;
+}
+
+// The network thread never waits on the GUI thread, so blocking on it
+// from there cannot deadlock.
+void HttpServer::stop() {
+    if (!m_thread->isRunning()) return;
+    QMetaObject::invokeMethod(this, [this]() { shutdown(); }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+}
+
+// The QTcpServer is created here, on the network thread, and deleted by
+// shutdown(), so the server can be started again after stop().
+bool HttpServer::listen() {
+    if (!m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &HttpServer::onNewConnection);
+    }
     if (m_server->listen(QHostAddress::Any, m_port)) {
         qDebug() << "HTTP server started on port" << m_port;
         return true;
@@ -79,50 +194,409 @@ bool HttpServer::start(quint16 port) {
     return false;
 }
 
-void HttpServer::stop() {
-    if (m_server->isListening()) {
-        m_server->close();
+// Runs on the network thread: closes every socket there and hands the
+// server object back to the main thread for destruction.
+void HttpServer::shutdown() {
+    m_broadcastTimer->stop();
+    m_keyframeTimer->stop();
+    if (m_server && m_server->isListening()) {
         qDebug() << "HTTP server stopped";
     }
+    // Accepted sockets are children of the QTcpServer.
+    delete m_server;
+    m_server = nullptr;
+    m_connections.clear();
+    m_sseClients.clear();
+    m_wsClients.clear();
+    m_pushClients.clear();
+    moveToThread(QCoreApplication::instance()->thread());
 }
 
 void HttpServer::onNewConnection() {
-    QTcpSocket* socket = m_server->nextPendingConnection();
-    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(); });
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_connections.remove(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, this, &HttpServer::onReadyRead);
+
+        // Idle keep-alive connections are closed after a timeout.
+        Connection& connection = m_connections[socket];
+        connection.idleTimer = new QTimer(socket);
+        connection.idleTimer->setSingleShot(true);
+        connect(connection.idleTimer, &QTimer::timeout, socket, &QTcpSocket::disconnectFromHost);
+        connection.idleTimer->start(KeepAliveTimeoutMs);
+    }
 }
 
 void HttpServer::onReadyRead() {
     QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
     if (!socket) return;
 
-    QByteArray requestData = socket->readAll();
-    QString request = QString::fromUtf8(requestData);
+    if (m_wsClients.contains(socket)) {
+        onWebSocketData(socket);
+        return;
+    }
+
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+        // SSE clients have nothing more to say.
+        socket->readAll();
+        return;
+    }
+    it->parser.append(socket->readAll());
+    it->idleTimer->start(KeepAliveTimeoutMs);
+    processRequests(socket);
+}
 
-    QStringList lines = request.split("\r\n");
-    if (lines.isEmpty()) return;
+// Answers every complete (possibly pipelined) request in order. A handler
+// may hand the socket over to SSE/WebSocket, close it, or leave it waiting
+// for an answer from another thread. A buffer overflow is answered even
+// while waiting; the pending answer is then dropped.
+void HttpServer::processRequests(QTcpSocket* socket) {
+    HttpRequest request;
+    for (;;) {
+        auto it = m_connections.find(socket);
+        if (it == m_connections.end() || socket->state() != QAbstractSocket::ConnectedState) {
+            return;
+        }
+        if (it->parser.errorStatus() != 0) {
+            sendError(socket, it->parser.errorStatus());
+            return;
+        }
+        if (it->waiting) {
+            return;
+        }
+        HttpRequestParser::Status status = it->parser.next(request);
+        if (status == HttpRequestParser::NeedMoreData) {
+            return;
+        }
+        if (status == HttpRequestParser::Error) {
+            sendError(socket, it->parser.errorStatus());
+            return;
+        }
+        handleRequest(socket, request);
+    }
+}
 
-    QString firstLine = lines.first();
-    QStringList parts = firstLine.split(" ");
+void HttpServer::handleRequest(QTcpSocket* socket, const HttpRequest& request) {
+    const QByteArray& path = request.path;
 
-    if (parts.size() < 2) {
-        socket->close();
+    if (path == "/api/latency") {
+        if (request.method == "POST") {
+            receiveLatency(socket, request);
+        } else {
+            sendResponse(socket, request, 405, "text/plain", "Method Not Allowed", "Allow: POST\r\n");
+        }
+        return;
+    }
+    if (request.method != "GET" && request.method != "HEAD") {
+        sendResponse(socket, request, 405, "text/plain", "Method Not Allowed", "Allow: GET, HEAD\r\n");
         return;
     }
-
-    QString path = parts[1];
 
     if (path == "/" || path.startsWith("/index")) {
-        sendHtml(socket);
+        sendHtml(socket, request);
     } else if (path == "/query" || path == "/api/stats") {
-        sendJson(socket);
+        sendJson(socket, request);
+    } else if (path == "/api/keys") {
+        sendKeys(socket, request);
+    } else if (path == "/api/transitions") {
+        sendTransitions(socket, request);
+    } else if (path == "/api/history") {
+        sendHistory(socket, request);
+    } else if (path == "/api/render") {
+        sendRender(socket, request);
+    } else if (path == "/api/sources") {
+        sendSources(socket, request);
+    } else if (path == "/api/layout") {
+        sendLayout(socket, request);
+    } else if (path == "/metrics") {
+        sendMetrics(socket, request);
     } else if (path == "/events" || path == "/sse") {
         sendSse(socket);
+    } else if (path == "/ws") {
+        if (request.header("upgrade").toLower() == "websocket"
+            && !request.header("sec-websocket-key").isEmpty()) {
+            upgradeWebSocket(socket, request);
+        } else {
+            sendResponse(socket, request, 400, "text/plain", "Bad Request");
+        }
     } else {
-        sendNotFound(socket);
+        sendNotFound(socket, request);
     }
 }
 
-void HttpServer::sendHtml(QTcpSocket* socket) {
+static const char* statusText(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    default: return "Unknown";
+    }
+}
+
+void HttpServer::sendResponse(QTcpSocket* socket, const HttpRequest& request, int status,
+                              const QByteArray& contentType, const QByteArray& body,
+                              const QByteArray& extraHeaders) {
+    const bool keepAlive = request.keepAlive();
+
+    QByteArray response;
+    response.reserve(256 + body.size());
+    response += "HTTP/1.1 " + QByteArray::number(status) + " " + statusText(status) + "\r\n";
+    if (!contentType.isEmpty()) {
+        response += "Content-Type: " + contentType + "\r\n";
+    }
+    response += "Access-Control-Allow-Origin: *\r\n";
+    if (status != 204 && status != 304) {
+        response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    }
+    response += extraHeaders;
+    if (keepAlive) {
+        response += "Connection: keep-alive\r\n";
+        response += "Keep-Alive: timeout=" + QByteArray::number(KeepAliveTimeoutMs / 1000) + "\r\n";
+    } else {
+        response += "Connection: close\r\n";
+    }
+    response += "\r\n";
+    if (request.method != "HEAD") {
+        response += body;
+    }
+
+    socket->write(response);
+    Metrics::instance()->add(Metrics::BytesWritten, static_cast<quint64>(response.size()));
+    if (!keepAlive) {
+        socket->disconnectFromHost();
+    }
+}
+
+void HttpServer::sendError(QTcpSocket* socket, int status) {
+    QByteArray body = statusText(status);
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " + body + "\r\n";
+    response += "Content-Type: text/plain\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n";
+    response += "\r\n";
+    response += body;
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+// Push frames go through here so each client's traffic is accounted.
+void HttpServer::writeToClient(QTcpSocket* client, const QByteArray& data) {
+    client->write(data);
+    m_pushClients[client].bytesWritten += static_cast<quint64>(data.size());
+    Metrics::instance()->add(Metrics::BytesWritten, static_cast<quint64>(data.size()));
+}
+
+void HttpServer::addPushClient(QTcpSocket* client) {
+    connect(client, &QTcpSocket::bytesWritten, this, [this, client]() {
+        onClientDrained(client);
+    });
+    connect(client, &QTcpSocket::disconnected, this, [this, client]() {
+        removePushClient(client);
+    });
+    updateKeyframeTimer();
+    scheduleBroadcast();
+}
+
+void HttpServer::removePushClient(QTcpSocket* client) {
+    m_sseClients.removeAll(client);
+    m_wsClients.remove(client);
+    auto it = m_pushClients.find(client);
+    if (it != m_pushClients.end()) {
+        // May be running its own timeout, which aborted the client.
+        if (it->stallTimer) {
+            it->stallTimer->deleteLater();
+        }
+        m_pushClients.erase(it);
+    }
+    updateKeyframeTimer();
+}
+
+// Decides whether a broadcast frame is written to the client. Frames for a
+// client that is over the high-water mark are dropped rather than queued,
+// so a stalled reader costs at most HighWaterBytes of memory.
+bool HttpServer::admitFrame(QTcpSocket* client) {
+    PushClient& state = m_pushClients[client];
+    if (!state.stalled) {
+        if (client->bytesToWrite() <= HighWaterBytes) {
+            return true;
+        }
+        state.stalled = true;
+        state.stalledSince.start();
+        if (!state.stallTimer) {
+            state.stallTimer = new QTimer(client);
+            state.stallTimer->setSingleShot(true);
+            connect(state.stallTimer, &QTimer::timeout, this, [this, client]() { evictStalled(client); });
+        }
+        state.stallTimer->start(MaxStallMs);
+    }
+    ++state.framesDropped;
+    Metrics::instance()->add(Metrics::PushFramesDropped);
+    return false;
+}
+
+// Fired MaxStallMs after a client stalled unless it drained in between,
+// so a stalled client is dropped even while nothing is broadcast.
+void HttpServer::evictStalled(QTcpSocket* client) {
+    auto it = m_pushClients.find(client);
+    if (it == m_pushClients.end() || !it->stalled) {
+        return;
+    }
+    qDebug() << "Disconnecting push client" << client->peerAddress().toString()
+             << "after" << it->stalledSince.elapsed() << "ms behind";
+    Metrics::instance()->add(Metrics::PushEvictions);
+    client->abort();
+}
+
+// A stalled client that has drained below the low-water mark gets one
+// keyframe of the last broadcast state; the deltas that follow apply to it.
+void HttpServer::onClientDrained(QTcpSocket* client) {
+    auto it = m_pushClients.find(client);
+    if (it == m_pushClients.end() || !it->stalled || client->bytesToWrite() > LowWaterBytes) {
+        return;
+    }
+    it->stalled = false;
+    it->stallTimer->stop();
+    ++it->catchUps;
+    Metrics::instance()->add(Metrics::PushCatchUps);
+
+    auto ws = m_wsClients.constFind(client);
+    if (ws != m_wsClients.constEnd()) {
+        writeToClient(client, WebSocket::encodeFrame(WebSocket::Binary, wsStatsFrame(fullState(), ws->fields)));
+    } else {
+        writeToClient(client, sseFrame(fullState()));
+    }
+}
+
+QByteArray HttpServer::detachConnection(QTcpSocket* socket) {
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+        return QByteArray();
+    }
+    QByteArray buffered = it->parser.takeBuffered();
+    delete it->idleTimer;
+    m_connections.erase(it);
+    return buffered;
+}
+
+static quint32 crc32(const QByteArray& data) {
+    static const auto table = []() {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (char ch : data) {
+        crc = table[(crc ^ static_cast<quint8>(ch)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void appendLE32(QByteArray& out, quint32 value) {
+    for (int i = 0; i < 4; ++i) {
+        out.append(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+// qCompress() yields a 4-byte length prefix and a zlib stream (2-byte
+// header, raw deflate, 4-byte Adler-32). Rewrap the deflate data as gzip.
+static QByteArray gzipCompress(const QByteArray& data) {
+    QByteArray zlib = qCompress(data, 9);
+    if (zlib.size() < 10) return QByteArray();
+
+    static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 2, '\xff' };
+    QByteArray gzip;
+    gzip.reserve(zlib.size() + 12);
+    gzip.append(header, sizeof(header));
+    gzip.append(zlib.constData() + 6, zlib.size() - 10);
+    appendLE32(gzip, crc32(data));
+    appendLE32(gzip, static_cast<quint32>(data.size()));
+    return gzip;
+}
+
+static QByteArray strongEtag(const QByteArray& data, const char* suffix) {
+    QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex().left(16);
+    return "\"" + hash + suffix + "\"";
+}
+
+// If-None-Match uses weak comparison, so W/ prefixes are ignored.
+static bool etagMatches(const QByteArray& ifNoneMatch, const QByteArray& etag) {
+    for (QByteArray tag : ifNoneMatch.split(',')) {
+        tag = tag.trimmed();
+        if (tag.startsWith("W/")) tag.remove(0, 2);
+        if (tag == etag || tag == "*") return true;
+    }
+    return false;
+}
+
+static bool acceptsGzip(const QByteArray& acceptEncoding) {
+    for (const QByteArray& entry : acceptEncoding.split(',')) {
+        QList<QByteArray> params = entry.split(';');
+        QByteArray coding = params.takeFirst().trimmed().toLower();
+        if (coding != "gzip" && coding != "*") continue;
+        bool refused = false;
+        for (const QByteArray& param : params) {
+            QByteArray p = param.trimmed();
+            if (p.startsWith("q=") && p.mid(2).toDouble() <= 0.0) refused = true;
+        }
+        return !refused;
+    }
+    return false;
+}
+
+HttpServer::CachedPage HttpServer::buildPage() const {
+    CachedPage page;
+    page.identity = renderHtml().toUtf8();
+    page.etag = strongEtag(page.identity, "");
+    page.gzip = gzipCompress(page.identity);
+    page.gzipEtag = strongEtag(page.identity, "-gz");
+    page.layoutJson = generateLayoutJson();
+    qDebug() << "Overlay page rendered:" << page.identity.size() << "bytes,"
+             << page.gzip.size() << "gzipped";
+    return page;
+}
+
+void HttpServer::sendHtml(QTcpSocket* socket, const HttpRequest& request) {
+    const CachedPage& cached = m_page;
+
+    const bool gzip = !cached.gzip.isEmpty() && acceptsGzip(request.header("accept-encoding"));
+    const QByteArray& etag = gzip ? cached.gzipEtag : cached.etag;
+
+    // The overlay must pick up layout changes on reload, so browsers
+    // revalidate every time and normally get an empty 304.
+    QByteArray headers = "ETag: " + etag + "\r\n";
+    headers += "Cache-Control: no-cache\r\n";
+    headers += "Vary: Accept-Encoding\r\n";
+
+    if (etagMatches(request.header("if-none-match"), etag)) {
+        sendResponse(socket, request, 304, QByteArray(), QByteArray(), headers);
+        return;
+    }
+    if (gzip) {
+        headers += "Content-Encoding: gzip\r\n";
+    }
+    sendResponse(socket, request, 200, "text/html; charset=UTF-8",
+                 gzip ? cached.gzip : cached.identity, headers);
+}
+
+QString HttpServer::renderHtml() const {
     Config* config = Config::instance();
     QString html = R"(<!DOCTYPE html>
 <html>
@@ -165,10 +639,11 @@ void HttpServer::sendHtml(QTcpSocket* socket) {
         const unitWidth = )" + QString::number(config->unitWidth()) + R"(;
         const unitHeight = )" + QString::number(config->unitHeight()) + R"(;
         const keySpacing = )" + QString::number(config->keySpacing()) + R"(;
-        const keys = )" + generateKeyboardJson() + R"(;
+        let keys = )" + QString::fromUtf8(generateKeyboardJson()) + R"(;
         
         function renderKeyboard() {
             const kb = document.getElementById('keyboard');
+            kb.textContent = '';
             keys.forEach(k => {
                 const keyDiv = document.createElement('div');
                 keyDiv.className = 'key';
@@ -198,180 +673,956 @@ void HttpServer::sendHtml(QTcpSocket* socket) {
             document.getElementById('total').textContent = 'Total: ' + data.totalKeyPresses;
         }
         
+        // Frames carry a sequence number. Keyframes replace the state,
+        // deltas only carry changed fields and must follow without a gap.
+        let state = null;
+        let lastSeq = -1;
+        let es = null;
+        
+        function applyFrame(data) {
+            if (data.key) {
+                state = { pressed: [], kps: 0, totalKeyPresses: 0, keyCounts: {} };
+                Object.assign(state, data);
+            } else if (!state || data.seq !== lastSeq + 1) {
+                reconnect();
+                return;
+            } else {
+                if (data.pressed) state.pressed = data.pressed;
+                if (data.kps !== undefined) state.kps = data.kps;
+                if (data.totalKeyPresses !== undefined) state.totalKeyPresses = data.totalKeyPresses;
+                if (data.keyCounts) Object.assign(state.keyCounts, data.keyCounts);
+            }
+            lastSeq = data.seq;
+            updateKeys(state);
+            if (data.t !== undefined) echoLatency(data.t);
+        }
+        
+        // Traced frames carry the hook stamp of the input they show; post
+        // it back once painted so the server can measure hook-to-screen
+        // latency. At most four reports per second.
+        let lastEcho = 0;
+        function echoLatency(stamp) {
+            const now = performance.now();
+            if (now - lastEcho < 250) return;
+            lastEcho = now;
+            requestAnimationFrame(() => setTimeout(() => {
+                fetch('/api/latency', { method: 'POST', body: String(stamp) }).catch(() => {});
+            }, 0));
+        }
+        
+        // The server pushes the new layout when its file changes; key sizes
+        // come from the config, so a change there needs the page itself.
+        function applyLayout(layout) {
+            if (layout.unitWidth !== unitWidth || layout.unitHeight !== unitHeight
+                || layout.keySpacing !== keySpacing) {
+                location.reload();
+                return;
+            }
+            keys = layout.keys;
+            renderKeyboard();
+            if (state) updateKeys(state);
+        }
+        
+        function applyEvent(event) {
+            if (event.event === 'layout') applyLayout(event.layout);
+            else if (event.event === 'reload') location.reload();
+        }
+        
+        function reconnect() {
+            if (es) es.close();
+            state = null;
+            setTimeout(connect, 1000);
+        }
+        
         function connect() {
-            const es = new EventSource('/events');
-            es.onmessage = e => updateKeys(JSON.parse(e.data));
-            es.onerror = () => es.close();
+            es = new EventSource('/events');
+            es.onmessage = e => applyFrame(JSON.parse(e.data));
+            es.addEventListener('layout', e => applyLayout(JSON.parse(e.data)));
+            es.addEventListener('reload', () => location.reload());
+            es.onerror = () => reconnect();
+        }
+        
+        // WebSocket frames are binary: u8 flags, varint seq, [varint stamp], u8 field mask,
+        // then a 32-byte pressed bitmap, varint kps, varint total and
+        // varint-encoded count changes for the fields present.
+        function applyBinary(buffer) {
+            const dv = new DataView(buffer);
+            let pos = 0;
+            const varint = () => {
+                let value = 0, scale = 1, b;
+                do {
+                    b = dv.getUint8(pos++);
+                    value += (b & 0x7f) * scale;
+                    scale *= 128;
+                } while (b & 0x80);
+                return value;
+            };
+            
+            const flags = dv.getUint8(pos++);
+            const keyframe = flags & 1;
+            const seq = varint();
+            const stamp = (flags & 2) ? varint() : -1;
+            const fields = dv.getUint8(pos++);
+            if (keyframe || !state) {
+                state = { pressed: [], kps: 0, totalKeyPresses: 0, keyCounts: {} };
+            }
+            if (fields & 1) {
+                const pressed = [];
+                for (let i = 0; i < 32; i++) {
+                    const b = dv.getUint8(pos + i);
+                    for (let bit = 0; b && bit < 8; bit++) {
+                        if (b & (1 << bit)) pressed.push(i * 8 + bit);
+                    }
+                }
+                pos += 32;
+                state.pressed = pressed;
+            }
+            if (fields & 2) state.kps = varint();
+            if (fields & 4) state.totalKeyPresses = varint();
+            if (fields & 8) {
+                for (let n = varint(); n > 0; n--) {
+                    const vk = dv.getUint8(pos++);
+                    const value = varint();
+                    state.keyCounts[vk] = keyframe ? value : (state.keyCounts[vk] || 0) + value;
+                }
+            }
+            lastSeq = seq;
+            updateKeys(state);
+            if (stamp >= 0) echoLatency(stamp);
+        }
+        
+        // Prefer the WebSocket; fall back to SSE if it cannot be opened.
+        function connectWs() {
+            const ws = new WebSocket('ws://' + location.host + '/ws');
+            let opened = false;
+            ws.binaryType = 'arraybuffer';
+            ws.onopen = () => {
+                opened = true;
+                ws.send('pressed,kps,total');
+            };
+            // Stats frames are binary; page events arrive as JSON text.
+            ws.onmessage = e => typeof e.data === 'string' ? applyEvent(JSON.parse(e.data)) : applyBinary(e.data);
+            ws.onclose = () => {
+                state = null;
+                if (opened) setTimeout(connectWs, 1000);
+                else connect();
+            };
         }
         
         renderKeyboard();
-        connect();
+        connectWs();
     </script>
 </body>
 </html>)";
 
-    QString response = "HTTP/1.1 200 OK\r\n";
-    response += "Content-Type: text/html; charset=UTF-8\r\n";
-    response += "Access-Control-Allow-Origin: *\r\n";
-    response += "Content-Length: " + QString::number(html.toUtf8().size()) + "\r\n";
-    response += "Connection: close\r\n";
-    response += "\r\n";
-    response += html;
+    return html;
+}
 
-    socket->write(response.toUtf8());
-    socket->flush();
-    socket->close();
+void HttpServer::sendJson(QTcpSocket* socket, const HttpRequest& request) {
+    sendCachedJson(socket, request, m_statsJson, &HttpServer::renderStatsJson);
 }
 
-void HttpServer::sendJson(QTcpSocket* socket) {
-    QString response;
-    if (m_stats) {
-        QJsonObject json;
-        json["totalKeyPresses"] = m_stats->totalKeyPresses();
-        json["kps"] = m_stats->kps();
-        
-        QJsonObject keyCounts;
-        for (auto it = m_stats->keyCounts().constBegin(); it != m_stats->keyCounts().constEnd(); ++it) {
-            keyCounts[QString::number(it.key())] = it.value();
+void HttpServer::sendKeys(QTcpSocket* socket, const HttpRequest& request) {
+    sendCachedJson(socket, request, m_keysJson, &HttpServer::renderKeysJson);
+}
+
+void HttpServer::sendCachedJson(QTcpSocket* socket, const HttpRequest& request, CachedJson& cache,
+                                QByteArray (*render)(const StatsSnapshot&)) {
+    if (!m_stats) {
+        sendResponse(socket, request, 500, "text/plain", "Stats not available");
+        return;
+    }
+
+    const std::shared_ptr<const StatsSnapshot> snapshot = m_stats->snapshot();
+    const quint64 version = snapshot->version;
+    if (!cache.valid || cache.version != version) {
+        cache.body = render(*snapshot);
+        cache.etag = "\"" + m_etagEpoch + "-" + QByteArray::number(version) + "\"";
+        cache.version = version;
+        cache.valid = true;
+    }
+
+    QByteArray headers = "ETag: " + cache.etag + "\r\n";
+    headers += "Cache-Control: no-cache\r\n";
+
+    if (etagMatches(request.header("if-none-match"), cache.etag)) {
+        sendResponse(socket, request, 304, QByteArray(), QByteArray(), headers);
+        return;
+    }
+    sendResponse(socket, request, 200, "application/json", cache.body, headers);
+}
+
+// Histogram buckets are trimmed after the last non-empty one.
+static void writeTiming(JsonWriter& json, const char* name, const TimingStats& series) {
+    if (!series.count()) return;
+
+    json.key(name).beginObject();
+    json.key("count").value(series.count());
+    json.key("meanMs").value(series.mean());
+    json.key("stddevMs").value(series.stddev());
+    json.key("minMs").value(static_cast<quint64>(series.min()));
+    json.key("maxMs").value(static_cast<quint64>(series.max()));
+    int used = LogHistogram::BucketCount;
+    while (used > 0 && !series.histogram().bucket(used - 1)) {
+        --used;
+    }
+    json.key("histogram").beginArray();
+    for (int i = 0; i < used; ++i) {
+        json.value(static_cast<quint64>(series.histogram().bucket(i)));
+    }
+    json.endArray();
+    json.endObject();
+}
+
+QByteArray HttpServer::renderStatsJson(const StatsSnapshot& stats) {
+    QByteArray out;
+    out.reserve(static_cast<int>(64 + stats.keyCounts.size() * 12 + stats.timing.size() * 256));
+
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("totalKeyPresses").value(stats.totalKeyPresses);
+    json.key("kps").value(stats.kps);
+    json.key("kps1s").value(stats.kps1s);
+    json.key("kps5s").value(stats.kps5s);
+    json.key("peakKps").value(stats.peakKps);
+
+    json.key("keyCounts").beginObject();
+    for (auto it = stats.keyCounts.constBegin(); it != stats.keyCounts.constEnd(); ++it) {
+        json.key(it.key()).value(it.value());
+    }
+    json.endObject();
+
+    json.key("timing").beginObject();
+    for (const KeyTimingSummary& key : stats.timing) {
+        json.key(key.vkCode).beginObject();
+        writeTiming(json, "hold", key.hold);
+        writeTiming(json, "interval", key.interval);
+        json.endObject();
+    }
+    json.endObject();
+    json.endObject();
+
+    return out;
+}
+
+QByteArray HttpServer::renderKeysJson(const StatsSnapshot& stats) {
+    QByteArray out;
+    out.reserve(64 + stats.keyCounts.size() * 12);
+
+    JsonWriter json(out);
+    json.beginObject();
+
+    json.key("pressed").beginArray();
+    for (int vk : stats.pressedKeys) {
+        json.value(vk);
+    }
+    json.endArray();
+
+    json.key("keyCounts").beginObject();
+    for (auto it = stats.keyCounts.constBegin(); it != stats.keyCounts.constEnd(); ++it) {
+        json.key(it.key()).value(it.value());
+    }
+    json.endObject();
+
+    json.key("kps").value(stats.kps);
+    json.key("totalKeyPresses").value(stats.totalKeyPresses);
+    json.endObject();
+
+    return out;
+}
+
+// GET /api/history?from=&to=&step=&keys=1 with times in ms since the epoch.
+// Defaults to the last hour in one-minute steps.
+void HttpServer::sendHistory(QTcpSocket* socket, const HttpRequest& request) {
+    HistoryStore::Query query;
+    bool ok = true;
+    auto param = [&](const char* name, qint64 fallback) {
+        const QByteArray value = request.queryValue(name);
+        if (value.isEmpty()) return fallback;
+        bool valid = false;
+        const qint64 parsed = value.toLongLong(&valid);
+        ok = ok && valid;
+        return parsed;
+    };
+    query.nowMs = QDateTime::currentMSecsSinceEpoch();
+    query.toMs = param("to", query.nowMs);
+    query.fromMs = param("from", query.toMs - 60 * 60 * 1000);
+    query.stepMs = param("step", 60 * 1000);
+    query.perKey = request.queryValue("keys") == "1";
+    if (!ok || query.stepMs <= 0 || !m_stats) {
+        sendResponse(socket, request, 400, "text/plain", "Bad Request");
+        return;
+    }
+
+    const KeyStats* stats = m_stats;
+    answerAsync(m_stats, socket, request, [stats, query]() {
+        return renderHistory(*stats, query);
+    });
+}
+
+HttpServer::Reply HttpServer::renderHistory(const KeyStats& stats, const HistoryStore::Query& query) {
+    HistoryStore::Series series;
+    if (!stats.history().query(query, series)) {
+        return { 400, "Bad Request" };
+    }
+
+    QByteArray out;
+    out.reserve(128 + series.totals.size() * 4 * (1 + series.keys.size()));
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("from").value(series.fromMs);
+    json.key("to").value(series.fromMs + series.stepMs * series.totals.size());
+    json.key("step").value(series.stepMs);
+    json.key("resolution").value(series.resolutionMs);
+
+    json.key("totals").beginArray();
+    for (quint32 count : series.totals) {
+        json.value(static_cast<quint64>(count));
+    }
+    json.endArray();
+
+    if (query.perKey) {
+        json.key("keys").beginObject();
+        for (auto it = series.keys.constBegin(); it != series.keys.constEnd(); ++it) {
+            json.key(it.key()).beginArray();
+            for (quint32 count : it.value()) {
+                json.value(static_cast<quint64>(count));
+            }
+            json.endArray();
         }
-        json["keyCounts"] = keyCounts;
+        json.endObject();
+    }
+    json.endObject();
 
-        QJsonDocument doc(json);
-        QString jsonStr = QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
+    return { 200, out };
+}
 
-        response = "HTTP/1.1 200 OK\r\n";
-        response += "Content-Type: application/json\r\n";
-        response += "Access-Control-Allow-Origin: *\r\n";
-        response += "Content-Length: " + QString::number(jsonStr.toUtf8().size()) + "\r\n";
-        response += "Connection: close\r\n";
-        response += "\r\n";
-        response += jsonStr;
-    } else {
-        response = "HTTP/1.1 500 Internal Server Error\r\n";
-        response += "Content-Type: text/plain\r\n";
-        response += "Content-Length: 17\r\n";
-        response += "Connection: close\r\n";
-        response += "\r\n";
-        response += "Stats not available";
+// GET /api/transitions?n=20: the n most frequent bigrams with their
+// interval histograms, and the n most frequent chords.
+void HttpServer::sendTransitions(QTcpSocket* socket, const HttpRequest& request) {
+    int n = 20;
+    const QByteArray nValue = request.queryValue("n");
+    if (!nValue.isEmpty()) {
+        bool ok = false;
+        n = nValue.toInt(&ok);
+        if (!ok || n < 1) {
+            sendResponse(socket, request, 400, "text/plain", "Bad Request");
+            return;
+        }
+        n = qMin(n, 1000);
+    }
+    if (!m_stats) {
+        sendResponse(socket, request, 500, "text/plain", "Stats not available");
+        return;
     }
 
-    socket->write(response.toUtf8());
-    socket->flush();
-    socket->close();
+    const KeyStats* stats = m_stats;
+    answerAsync(m_stats, socket, request, [stats, n]() {
+        return renderTransitions(stats->transitions(), n);
+    });
 }
 
-void HttpServer::sendKeys(QTcpSocket* socket) {
-    QString response;
-    if (m_stats) {
-        QJsonObject json;
-        
-        QJsonArray pressed;
-        for (int vk : m_stats->pressedKeys()) {
-            pressed.append(vk);
+HttpServer::Reply HttpServer::renderTransitions(const TransitionStats& stats, int n) {
+    const QVector<TransitionStats::Transition> transitions = stats.topTransitions(n);
+    const QVector<TransitionStats::Chord> chords = stats.topChords(n);
+
+    QByteArray out;
+    out.reserve(128 + transitions.size() * 160 + chords.size() * 40);
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("totalTransitions").value(stats.totalTransitions());
+    json.key("distinctTransitions").value(stats.distinctTransitions());
+    json.key("totalChords").value(stats.totalChords());
+    json.key("chordWindowMs").value(stats.chordWindow());
+
+    json.key("transitions").beginArray();
+    for (const TransitionStats::Transition& transition : transitions) {
+        json.beginObject();
+        json.key("from").value(transition.from);
+        json.key("to").value(transition.to);
+        json.key("count").value(static_cast<quint64>(transition.count));
+        if (transition.intervals) {
+            json.key("p50Ms").value(static_cast<quint64>(transition.intervals->percentile(0.5)));
+            json.key("p90Ms").value(static_cast<quint64>(transition.intervals->percentile(0.9)));
+            json.key("intervals").beginArray();
+            for (int i = 0; i < LogHistogram::BucketCount; ++i) {
+                json.value(static_cast<quint64>(transition.intervals->bucket(i)));
+            }
+            json.endArray();
         }
-        json["pressed"] = pressed;
-        
-        QJsonObject counts;
-        for (auto it = m_stats->keyCounts().constBegin(); it != m_stats->keyCounts().constEnd(); ++it) {
-            counts[QString::number(it.key())] = it.value();
+        json.endObject();
+    }
+    json.endArray();
+
+    json.key("chords").beginArray();
+    for (const TransitionStats::Chord& chord : chords) {
+        json.beginObject();
+        json.key("keys").beginArray();
+        for (int i = 0; i < chord.size; ++i) {
+            json.value(static_cast<int>(chord.keys[i]));
         }
-        json["keyCounts"] = counts;
-        
-        json["kps"] = m_stats->kps();
-        json["totalKeyPresses"] = m_stats->totalKeyPresses();
+        json.endArray();
+        json.key("count").value(static_cast<quint64>(chord.count));
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
 
-        QJsonDocument doc(json);
-        QString jsonStr = QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
+    return { 200, out };
+}
 
-        response = "HTTP/1.1 200 OK\r\n";
-        response += "Content-Type: application/json\r\n";
-        response += "Access-Control-Allow-Origin: *\r\n";
-        response += "Content-Length: " + QString::number(jsonStr.toUtf8().size()) + "\r\n";
-        response += "Connection: close\r\n";
-        response += "\r\n";
-        response += jsonStr;
-    } else {
-        response = "HTTP/1.1 500 Internal Server Error\r\n";
-        response += "Content-Type: text/plain\r\n";
-        response += "Content-Length: 17\r\n";
-        response += "Connection: close\r\n";
-        response += "\r\n";
-        response += "Stats not available";
+void HttpServer::sendRender(QTcpSocket* socket, const HttpRequest& request) {
+    if (!m_renderScheduler) {
+        sendResponse(socket, request, 404, "text/plain", "No overlay window");
+        return;
     }
 
-    socket->write(response.toUtf8());
-    socket->flush();
-    socket->close();
+    const RenderScheduler* scheduler = m_renderScheduler;
+    answerAsync(m_renderScheduler, socket, request, [scheduler]() {
+        QByteArray out;
+        JsonWriter json(out);
+        json.beginObject();
+        json.key("targetFps").value(scheduler->targetFps());
+        json.key("frames").value(scheduler->frames());
+        json.key("droppedFrames").value(scheduler->droppedFrames());
+        json.key("events").value(scheduler->events());
+        json.key("eventsPerFrame").value(scheduler->eventsPerFrame());
+        json.key("maxEventsPerFrame").value(scheduler->maxEventsPerFrame());
+        json.endObject();
+        return Reply{ 200, out };
+    });
 }
 
-void HttpServer::sendNotFound(QTcpSocket* socket) {
-    QString response = "HTTP/1.1 404 Not Found\r\n";
-    response += "Content-Type: text/plain\r\n";
-    response += "Content-Length: 9\r\n";
-    response += "Connection: close\r\n";
-    response += "\r\n";
-    response += "Not Found";
+void HttpServer::sendLayout(QTcpSocket* socket, const HttpRequest& request) {
+    sendResponse(socket, request, 200, "application/json", m_page.layoutJson, "Cache-Control: no-cache\r\n");
+}
+
+// GET /api/sources: the hub's nodes with their own counters. The combined
+// numbers are in /api/stats.
+void HttpServer::sendSources(QTcpSocket* socket, const HttpRequest& request) {
+    if (!m_hub) {
+        sendResponse(socket, request, 404, "text/plain", "Hub mode is not enabled");
+        return;
+    }
 
-    socket->write(response.toUtf8());
-    socket->flush();
-    socket->close();
+    const HubServer* hub = m_hub;
+    answerAsync(m_hub, socket, request, [hub]() {
+        return renderSources(*hub);
+    });
 }
 
-QString HttpServer::getPressedKeysJson() const {
-    if (!m_stats) return "{}";
+HttpServer::Reply HttpServer::renderSources(const HubServer& hub) {
+    const QVector<HubServer::Source>& sources = hub.sources();
+    QByteArray out;
+    out.reserve(64 + sources.size() * 1024);
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("port").value(static_cast<int>(hub.port()));
+    json.key("connected").value(hub.connectedSources());
+    json.key("sources").beginArray();
+    for (const HubServer::Source& source : sources) {
+        json.beginObject();
+        json.key("name").value(source.name);
+        json.key("address").value(source.address);
+        json.key("connected").value(source.connected);
+        json.key("events").value(source.events);
+        json.key("batches").value(source.batches);
+        json.key("lastSeenMs").value(source.lastSeen.isValid() ? source.lastSeen.elapsed() : qint64(-1));
+        json.key("totalKeyPresses").value(source.totalKeyPresses);
+        // The meter only moves on presses; bring a copy up to now.
+        KpsMeter kps = source.kps;
+        kps.advance(hub.now());
+        json.key("kps5s").value(kps.rate(KpsMeter::Window5s));
+        json.key("pressed").beginArray();
+        for (int vk : source.pressedKeys) {
+            json.value(vk);
+        }
+        json.endArray();
+        json.key("keyCounts").beginObject();
+        for (auto it = source.keyCounts.constBegin(); it != source.keyCounts.constEnd(); ++it) {
+            json.key(it.key()).value(it.value());
+        }
+        json.endObject();
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    return { 200, out };
+}
 
-    QJsonObject json;
-    QJsonObject keyCounts;
-    for (auto it = m_stats->keyCounts().constBegin(); it != m_stats->keyCounts().constEnd(); ++it) {
-        keyCounts[QString::number(it.key())] = it.value();
+// Live KeyStats and RenderScheduler state belongs to the GUI thread, so
+// queries on it run there and the answer comes back as a queued call.
+// Pipelined requests behind it on the same connection wait their turn.
+void HttpServer::answerAsync(QObject* context, QTcpSocket* socket, const HttpRequest& request,
+                             std::function<Reply()> query) {
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) return;
+    it->waiting = true;
+
+    // The server is only deleted on the GUI thread, where the query runs.
+    QPointer<HttpServer> server(this);
+    QPointer<QTcpSocket> client(socket);
+    QMetaObject::invokeMethod(context, [server, client, request, query]() {
+        const Reply reply = query();
+        if (!server) return;
+        HttpServer* self = server;
+        QMetaObject::invokeMethod(self, [self, client, request, reply]() {
+            auto it = client ? self->m_connections.find(client) : self->m_connections.end();
+            if (it == self->m_connections.end()
+                || client->state() != QAbstractSocket::ConnectedState) return;
+            it->waiting = false;
+            if (reply.status == 200) {
+                self->sendResponse(client, request, 200, "application/json", reply.body,
+                                   "Cache-Control: no-store\r\n");
+            } else {
+                self->sendResponse(client, request, reply.status, "text/plain", reply.body);
+            }
+            self->processRequests(client);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void HttpServer::sendMetrics(QTcpSocket* socket, const HttpRequest& request) {
+    QByteArray out;
+    out.reserve(4096 + m_pushClients.size() * 384);
+    Metrics::instance()->writeMetrics(out);
+    Latency::instance()->writeMetrics(out);
+
+    out += "# HELP keystatics_sse_clients Connected Server-Sent Events clients.\n";
+    out += "# TYPE keystatics_sse_clients gauge\n";
+    out += "keystatics_sse_clients " + QByteArray::number(m_sseClients.size()) + "\n";
+    out += "# HELP keystatics_ws_clients Connected WebSocket clients.\n";
+    out += "# TYPE keystatics_ws_clients gauge\n";
+    out += "keystatics_ws_clients " + QByteArray::number(m_wsClients.size()) + "\n";
+    out += "# HELP keystatics_http_connections Open request/response connections.\n";
+    out += "# TYPE keystatics_http_connections gauge\n";
+    out += "keystatics_http_connections " + QByteArray::number(m_connections.size()) + "\n";
+
+    // Per push client: traffic, what is still queued in the socket, and
+    // how far behind it is.
+    QByteArray written, queued, dropped, catchUps, lag;
+    for (auto it = m_pushClients.constBegin(); it != m_pushClients.constEnd(); ++it) {
+        QTcpSocket* client = it.key();
+        const PushClient& state = it.value();
+        const QByteArray labels = "{client=\"" + client->peerAddress().toString().toUtf8()
+            + ":" + QByteArray::number(client->peerPort()) + "\",type=\""
+            + (m_wsClients.contains(client) ? "ws" : "sse") + "\"} ";
+        written += "keystatics_client_bytes_written_total" + labels + QByteArray::number(state.bytesWritten) + "\n";
+        queued += "keystatics_client_queued_bytes" + labels + QByteArray::number(client->bytesToWrite()) + "\n";
+        dropped += "keystatics_client_frames_dropped_total" + labels + QByteArray::number(state.framesDropped) + "\n";
+        catchUps += "keystatics_client_catchups_total" + labels + QByteArray::number(state.catchUps) + "\n";
+        lag += "keystatics_client_lag_seconds" + labels
+            + QByteArray::number(state.stalled ? state.stalledSince.elapsed() / 1000.0 : 0.0) + "\n";
     }
-    json["keyCounts"] = keyCounts;
+    out += "# HELP keystatics_client_bytes_written_total Bytes written to each push client.\n";
+    out += "# TYPE keystatics_client_bytes_written_total counter\n";
+    out += written;
+    out += "# HELP keystatics_client_queued_bytes Bytes queued in each push client's socket.\n";
+    out += "# TYPE keystatics_client_queued_bytes gauge\n";
+    out += queued;
+    out += "# HELP keystatics_client_frames_dropped_total Frames skipped while the client was over the high-water mark.\n";
+    out += "# TYPE keystatics_client_frames_dropped_total counter\n";
+    out += dropped;
+    out += "# HELP keystatics_client_catchups_total Keyframes sent after the client drained.\n";
+    out += "# TYPE keystatics_client_catchups_total counter\n";
+    out += catchUps;
+    out += "# HELP keystatics_client_lag_seconds How long the client has been over the high-water mark.\n";
+    out += "# TYPE keystatics_client_lag_seconds gauge\n";
+    out += lag;
 
-    QJsonDocument doc(json);
-    return QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
+    sendResponse(socket, request, 200, "text/plain; version=0.0.4", out, "Cache-Control: no-store\r\n");
+}
+
+// The overlay page posts back the stamp of a traced frame once it has
+// been painted, closing the hook-to-screen loop.
+void HttpServer::receiveLatency(QTcpSocket* socket, const HttpRequest& request) {
+    bool ok = false;
+    const quint32 stamp = request.body.trimmed().toUInt(&ok);
+    if (!ok) {
+        sendResponse(socket, request, 400, "text/plain", "Bad Request");
+        return;
+    }
+    Latency::instance()->record(Latency::Echo, stamp);
+    sendResponse(socket, request, 204, QByteArray(), QByteArray());
+}
+
+void HttpServer::sendNotFound(QTcpSocket* socket, const HttpRequest& request) {
+    sendResponse(socket, request, 404, "text/plain", "Not Found");
 }
 
 void HttpServer::sendSse(QTcpSocket* socket) {
+    // The socket leaves request/response mode for good.
+    detachConnection(socket);
+
     QString response = "HTTP/1.1 200 OK\r\n";
     response += "Content-Type: text/event-stream\r\n";
     response += "Cache-Control: no-cache\r\n";
     response += "Connection: keep-alive\r\n";
     response += "Access-Control-Allow-Origin: *\r\n";
     response += "\r\n";
-    socket->write(response.toUtf8());
-    socket->flush();
+    writeToClient(socket, response.toUtf8());
     
-    sseClients.append(socket);
-    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
-        sseClients.removeAll(socket);
-    });
+    // A new client starts from the last broadcast state; the deltas that
+    // follow are computed against that same state.
+    writeToClient(socket, sseFrame(fullState()));
+
+    m_sseClients.append(socket);
+    addPushClient(socket);
+}
+
+void HttpServer::upgradeWebSocket(QTcpSocket* socket, const HttpRequest& request) {
+    QByteArray response = "HTTP/1.1 101 Switching Protocols\r\n";
+    response += "Upgrade: websocket\r\n";
+    response += "Connection: Upgrade\r\n";
+    response += "Sec-WebSocket-Accept: " + WebSocket::acceptKey(request.header("sec-websocket-key")) + "\r\n";
+    response += "\r\n";
+    writeToClient(socket, response);
+    writeToClient(socket, WebSocket::encodeFrame(WebSocket::Binary, wsStatsFrame(fullState(), WsAllFields)));
+
+    // Bytes after the upgrade request are already WebSocket frames.
+    WsClient client;
+    client.buffer = detachConnection(socket);
+    m_wsClients.insert(socket, client);
+    if (!client.buffer.isEmpty()) {
+        QMetaObject::invokeMethod(this, [this, socket]() {
+            if (m_wsClients.contains(socket)) {
+                onWebSocketData(socket);
+            }
+        }, Qt::QueuedConnection);
+    }
+    addPushClient(socket);
+}
+
+static quint8 parseSubscription(const WebSocket::Frame& frame) {
+    if (frame.opcode == WebSocket::Binary) {
+        return frame.payload.isEmpty() ? 0 : static_cast<quint8>(frame.payload[0]);
+    }
+
+    quint8 fields = 0;
+    for (const QByteArray& name : frame.payload.split(',')) {
+        QByteArray field = name.trimmed();
+        if (field == "pressed") fields |= 0x01;
+        else if (field == "kps") fields |= 0x02;
+        else if (field == "total") fields |= 0x04;
+        else if (field == "counts") fields |= 0x08;
+    }
+    return fields;
 }
 
-void HttpServer::broadcastSse() {
-    if (sseClients.isEmpty() || !m_stats) return;
+void HttpServer::onWebSocketData(QTcpSocket* socket) {
+    WsClient& client = m_wsClients[socket];
+    client.buffer.append(socket->readAll());
+
+    WebSocket::Frame frame;
+    for (;;) {
+        WebSocket::DecodeResult result = WebSocket::decodeFrame(client.buffer, frame, MaxWsMessageSize);
+        if (result == WebSocket::Incomplete) {
+            return;
+        }
+        if (result == WebSocket::Decoded && !(frame.opcode & 0x08)) {
+            // Reassemble fragmented messages; control frames may arrive
+            // between the fragments and are handled right away.
+            if (frame.opcode == WebSocket::Continuation) {
+                if (!client.messageOpcode
+                    || client.message.size() + frame.payload.size() > MaxWsMessageSize) {
+                    result = WebSocket::ProtocolError;
+                } else {
+                    client.message.append(frame.payload);
+                    if (frame.final) {
+                        frame.opcode = client.messageOpcode;
+                        frame.payload = client.message;
+                        client.messageOpcode = 0;
+                        client.message.clear();
+                    }
+                }
+            } else if (client.messageOpcode) {
+                result = WebSocket::ProtocolError;
+            } else if (!frame.final) {
+                client.messageOpcode = frame.opcode;
+                client.message = frame.payload;
+            }
+            if (result == WebSocket::Decoded && !frame.final) {
+                continue;
+            }
+        }
+        if (result == WebSocket::ProtocolError) {
+            socket->write(WebSocket::encodeFrame(WebSocket::Close, QByteArray("\x03\xea", 2)));
+            socket->disconnectFromHost();
+            return;
+        }
+
+        switch (frame.opcode) {
+        case WebSocket::Text:
+        case WebSocket::Binary: {
+            // Subscription: "pressed,kps,total,counts" or a one-byte field mask.
+            // A new subset starts with a keyframe of the fields it adds.
+            quint8 fields = parseSubscription(frame) & WsAllFields;
+            if (fields != client.fields) {
+                client.fields = fields;
+                writeToClient(socket, WebSocket::encodeFrame(WebSocket::Binary, wsStatsFrame(fullState(), fields)));
+            }
+            break;
+        }
+        case WebSocket::Ping:
+            writeToClient(socket, WebSocket::encodeFrame(WebSocket::Pong, frame.payload));
+            break;
+        case WebSocket::Close:
+            socket->write(WebSocket::encodeFrame(WebSocket::Close, frame.payload.left(2)));
+            socket->disconnectFromHost();
+            return;
+        default:
+            break;
+        }
+    }
+}
+
+void HttpServer::updateKeyframeTimer() {
+    if (!hasPushClients()) {
+        m_keyframeTimer->stop();
+    }
+}
+
+void HttpServer::scheduleBroadcast() {
+    if (!hasPushClients()) {
+        // Nobody would see the event, so it has no latency to trace.
+        quint32 unused;
+        Latency::instance()->takeIngested(unused);
+        return;
+    }
+    if (m_broadcastTimer->isActive()) {
+        return;
+    }
     
-    QJsonObject json;
-    QJsonArray pressed;
-    for (int vk : m_stats->pressedKeys()) {
-        pressed.append(vk);
-    }
-    json["pressed"] = pressed;
-    json["kps"] = m_stats->kps();
-    json["totalKeyPresses"] = m_stats->totalKeyPresses();
+    // Send right away unless the previous frame went out less than one
+    // frame interval ago; changes in between are coalesced.
+    qint64 sinceLast = m_lastBroadcast.elapsed();
+    if (sinceLast >= MinBroadcastIntervalMs) {
+        broadcast();
+    } else {
+        m_broadcastTimer->start(static_cast<int>(MinBroadcastIntervalMs - sinceLast));
+    }
+}
+
+bool HttpServer::computeDelta(StateDelta& delta, const StatsSnapshot& stats) {
+    delta.keyframe = m_keyframeDue;
+    if (stats.resetGeneration != m_sentState.resetGeneration) {
+        // Stats were reset or restored since the last frame; counters that
+        // went down are not visible as deltas, even if presses since then
+        // brought the total back up, so start over with a keyframe.
+        m_sentState = BroadcastState();
+        m_sentState.resetGeneration = stats.resetGeneration;
+        delta.keyframe = true;
+    }
     
-    QJsonObject keyCounts;
-    for (auto it = m_stats->keyCounts().constBegin(); it != m_stats->keyCounts().constEnd(); ++it) {
-        keyCounts[QString::number(it.key())] = it.value();
+    if (stats.pressedKeys != m_sentState.pressed) {
+        m_sentState.pressed = stats.pressedKeys;
+        delta.pressed = true;
+    }
+    if (stats.kps != m_sentState.kps) {
+        m_sentState.kps = stats.kps;
+        delta.kps = true;
+    }
+    if (stats.totalKeyPresses != m_sentState.totalKeyPresses) {
+        m_sentState.totalKeyPresses = stats.totalKeyPresses;
+        delta.total = true;
     }
-    json["keyCounts"] = keyCounts;
     
-    QJsonDocument doc(json);
-    QString data = "data: " + QString::fromUtf8(doc.toJson(QJsonDocument::Compact)) + "\r\n\r\n";
+    const KeyCounts& counts = stats.keyCounts;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        int& sent = m_sentState.keyCounts[it.key()];
+        if (sent != it.value()) {
+            delta.counts.append({it.key(), sent, it.value()});
+            sent = it.value();
+        }
+    }
     
-    for (QTcpSocket* client : sseClients) {
-        if (client->state() == QAbstractSocket::ConnectedState) {
-            client->write(data.toUtf8());
-            client->flush();
+    if (delta.keyframe) {
+        delta = fullState();
+    }
+    return delta.keyframe || delta.pressed || delta.kps || delta.total || !delta.counts.isEmpty();
+}
+
+HttpServer::StateDelta HttpServer::fullState() const {
+    StateDelta delta;
+    delta.keyframe = true;
+    delta.pressed = true;
+    delta.kps = true;
+    delta.total = true;
+    for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+        if (m_sentState.keyCounts[vk] != 0) {
+            delta.counts.append({vk, 0, m_sentState.keyCounts[vk]});
         }
     }
+    return delta;
+}
+
+const QByteArray& HttpServer::sseFrame(const StateDelta& delta) {
+    // The buffer keeps its capacity between frames unless a socket still
+    // shares the previous frame.
+    m_sseBuffer.resize(0);
+    m_sseBuffer.append("data: ", 6);
+
+    JsonWriter json(m_sseBuffer);
+    json.beginObject();
+    json.key("seq").value(m_seq);
+    if (delta.traced) {
+        json.key("t").value(static_cast<quint64>(delta.stamp));
+    }
+    if (delta.keyframe) {
+        json.key("key").value(true);
+    }
+    if (delta.pressed) {
+        json.key("pressed").beginArray();
+        for (int vk : m_sentState.pressed) {
+            json.value(vk);
+        }
+        json.endArray();
+    }
+    if (delta.kps) {
+        json.key("kps").value(m_sentState.kps);
+    }
+    if (delta.total) {
+        json.key("totalKeyPresses").value(m_sentState.totalKeyPresses);
+    }
+    if (delta.keyframe || !delta.counts.isEmpty()) {
+        json.key("keyCounts").beginObject();
+        for (const CountChange& change : delta.counts) {
+            json.key(change.vkCode).value(change.value);
+        }
+        json.endObject();
+    }
+    json.endObject();
+
+    m_sseBuffer.append("\n\n", 2);
+    return m_sseBuffer;
+}
+
+static void appendVarint(QByteArray& out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+// Binary stats frame:
+//   u8 flags (bit 0: keyframe, bit 1: traced), varint seq, [varint hook
+//   stamp if traced], u8 field mask, then per field:
+//   pressed: 32-byte bitmap (bit vk & 7 of byte vk >> 3)
+//   kps, total: varint
+//   counts: varint n, then n x (u8 vk, varint value); values are absolute
+//           in keyframes and increments in deltas
+QByteArray HttpServer::wsStatsFrame(const StateDelta& delta, quint8 fields) const {
+    quint8 present = 0;
+    if (delta.pressed) present |= WsPressed;
+    if (delta.kps) present |= WsKps;
+    if (delta.total) present |= WsTotal;
+    if (delta.keyframe || !delta.counts.isEmpty()) present |= WsCounts;
+    present &= fields;
+
+    QByteArray out;
+    out.reserve(48 + delta.counts.size() * 4);
+    out.append(static_cast<char>((delta.keyframe ? 1 : 0) | (delta.traced ? 2 : 0)));
+    appendVarint(out, m_seq);
+    if (delta.traced) {
+        appendVarint(out, delta.stamp);
+    }
+    out.append(static_cast<char>(present));
+
+    if (present & WsPressed) {
+        const quint64* words = m_sentState.pressed.words();
+        for (int w = 0; w < VkBitmap::WordCount; ++w) {
+            for (int b = 0; b < 8; ++b) {
+                out.append(static_cast<char>((words[w] >> (b * 8)) & 0xFF));
+            }
+        }
+    }
+    if (present & WsKps) {
+        appendVarint(out, static_cast<quint64>(qMax(0, m_sentState.kps)));
+    }
+    if (present & WsTotal) {
+        appendVarint(out, static_cast<quint64>(qMax(0, m_sentState.totalKeyPresses)));
+    }
+    if (present & WsCounts) {
+        appendVarint(out, static_cast<quint64>(delta.counts.size()));
+        for (const CountChange& change : delta.counts) {
+            out.append(static_cast<char>(change.vkCode));
+            int value = delta.keyframe ? change.value : change.value - change.previous;
+            appendVarint(out, static_cast<quint64>(qMax(0, value)));
+        }
+    }
+    return out;
+}
+
+void HttpServer::broadcast() {
+    if (!hasPushClients() || !m_stats) return;
+    
+    const qint64 startNs = Metrics::now();
+    StateDelta delta;
+    if (!computeDelta(delta, *m_stats->snapshot())) return;
+    Metrics* metrics = Metrics::instance();
+    
+    m_lastBroadcast.restart();
+    m_keyframeDue = false;
+    ++m_seq;
+    delta.traced = Latency::instance()->takeIngested(delta.stamp);
+    bool serialized = false;
+    
+    // Each payload is serialized once and shared by every client.
+    if (!m_sseClients.isEmpty()) {
+        const qint64 serializeNs = Metrics::now();
+        const QByteArray& data = sseFrame(delta);
+        metrics->timing(Metrics::Serialize, serializeNs);
+        serialized = true;
+        if (delta.traced) {
+            Latency::instance()->record(Latency::Serialize, delta.stamp);
+        }
+        // Iterate over a copy: an evicted client leaves the list.
+        const QList<QTcpSocket*> clients = m_sseClients;
+        for (QTcpSocket* client : clients) {
+            if (client->state() == QAbstractSocket::ConnectedState && admitFrame(client)) {
+                writeToClient(client, data);
+                metrics->add(Metrics::SseFramesSent);
+            }
+        }
+    }
+    
+    if (!m_wsClients.isEmpty()) {
+        QByteArray frames[WsAllFields + 1];
+        QVarLengthArray<QPair<QTcpSocket*, quint8>, 16> clients;
+        for (auto it = m_wsClients.constBegin(); it != m_wsClients.constEnd(); ++it) {
+            clients.append(qMakePair(it.key(), it.value().fields));
+        }
+        for (const auto& entry : clients) {
+            QTcpSocket* client = entry.first;
+            const quint8 fields = entry.second;
+            if (client->state() != QAbstractSocket::ConnectedState
+                || (!delta.keyframe && !delta.touches(fields)) || !admitFrame(client)) {
+                continue;
+            }
+            QByteArray& frame = frames[fields];
+            if (frame.isEmpty()) {
+                const qint64 serializeNs = Metrics::now();
+                frame = WebSocket::encodeFrame(WebSocket::Binary, wsStatsFrame(delta, fields));
+                metrics->timing(Metrics::Serialize, serializeNs);
+                if (delta.traced && !serialized) {
+                    Latency::instance()->record(Latency::Serialize, delta.stamp);
+                }
+                serialized = true;
+            }
+            writeToClient(client, frame);
+            metrics->add(Metrics::WsFramesSent);
+        }
+    }
+
+    if (delta.keyframe) {
+        m_keyframeTimer->stop();
+    } else if (!m_keyframeTimer->isActive()) {
+        m_keyframeTimer->start();
+    }
+
+    if (delta.traced && serialized) {
+        Latency::instance()->record(Latency::Write, delta.stamp);
+    }
+    metrics->timing(Metrics::Broadcast, startNs);
 }
@@ -20,38 +20,239 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QTimer>
+#include <QThread>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVarLengthArray>
 #include "keystats.h"
 #include "keylayout.h"
+#include "httpparser.h"
+#include "renderscheduler.h"
+#include "hubserver.h"
+#include <functional>
 
+class JsonWriter;
+
+// Serves the overlay page, the JSON API and the push streams from its own
+// network thread, so slow clients never hold up input handling or painting.
+// Stats are read from KeyStats snapshots; the few queries that need live
+// state are run on the GUI thread and answered asynchronously. The object
+// moves itself to that thread and therefore cannot have a parent.
 class HttpServer : public QObject {
     Q_OBJECT
 
 public:
-    explicit HttpServer(KeyStats* stats, QObject* parent = nullptr);
+    explicit HttpServer(KeyStats* stats);
     ~HttpServer();
 
+    // Called from the GUI thread. stop() closes all connections and ends
+    // the network thread; start() may be called again afterwards.
     bool start(quint16 port = 9863);
     void stop();
+    // The page is rendered from the layout on the calling (GUI) thread;
+    // connected overlays switch to the new layout without reloading.
     void setLayout(KeyLayout* layout);
+    void setRenderScheduler(RenderScheduler* scheduler) { m_renderScheduler = scheduler; }
+    // Enables /api/sources; the hub lives on the GUI thread.
+    void setHub(HubServer* hub) { m_hub = hub; }
 
 private slots:
     void onNewConnection();
     void onReadyRead();
 
 private:
-    void handleRequest(QTcpSocket* socket);
-    void sendHtml(QTcpSocket* socket);
-    void sendJson(QTcpSocket* socket);
-    void sendKeys(QTcpSocket* socket);
+    // Bits of the WebSocket stats frame; clients subscribe to a subset.
+    enum WsField : quint8 {
+        WsPressed = 0x01,
+        WsKps = 0x02,
+        WsTotal = 0x04,
+        WsCounts = 0x08,
+        WsAllFields = 0x0F
+    };
+
+    // Last state sent to push clients; deltas are computed against it.
+    struct BroadcastState {
+        int keyCounts[VkBitmap::Size] = {};
+        VkBitmap pressed;
+        int kps = 0;
+        int totalKeyPresses = 0;
+        quint64 resetGeneration = 0;
+    };
+
+    struct CountChange {
+        int vkCode;
+        int previous;
+        int value;
+    };
+
+    struct StateDelta {
+        bool keyframe = false;
+        bool pressed = false;
+        bool kps = false;
+        bool total = false;
+        QVarLengthArray<CountChange, 16> counts;
+        // Hook stamp of the oldest input event first shown by this frame.
+        bool traced = false;
+        quint32 stamp = 0;
+
+        bool touches(quint8 fields) const {
+            return ((fields & WsPressed) && pressed) || ((fields & WsKps) && kps)
+                || ((fields & WsTotal) && total) || ((fields & WsCounts) && !counts.isEmpty());
+        }
+    };
+
+    struct WsClient {
+        QByteArray buffer;
+        quint8 fields = WsAllFields;
+        // Opcode and payload so far of a fragmented message, 0 if none.
+        quint8 messageOpcode = 0;
+        QByteArray message;
+    };
+
+    // Outbound state of one SSE or WebSocket client. Once more than
+    // HighWaterBytes are queued in the socket the client stops receiving
+    // frames; when it has drained below LowWaterBytes it is sent a single
+    // keyframe with the latest state instead of everything it missed.
+    // A client that stays stalled for MaxStallMs is disconnected, also
+    // when no broadcast happens in the meantime.
+    struct PushClient {
+        quint64 bytesWritten = 0;
+        quint64 framesDropped = 0;
+        quint64 catchUps = 0;
+        bool stalled = false;
+        QElapsedTimer stalledSince;
+        QTimer* stallTimer = nullptr;   // owned by the socket
+    };
+
+    // Overlay page rendered once per layout/config change, kept both as
+    // identity and gzip bytes with a strong ETag for each variant, plus the
+    // layout JSON served at /api/layout and pushed on layout changes.
+    struct CachedPage {
+        QByteArray identity;
+        QByteArray gzip;
+        QByteArray etag;
+        QByteArray gzipEtag;
+        QByteArray layoutJson;
+    };
+
+    // What push clients are told when the page changes: a new layout is
+    // applied in place, a config change needs the page reloaded.
+    enum PageEvent {
+        LayoutEvent,
+        ReloadEvent
+    };
+
+    // Serialized JSON response for one KeyStats version, shared by all
+    // pollers until the stats change.
+    struct CachedJson {
+        bool valid = false;
+        quint64 version = 0;
+        QByteArray body;
+        QByteArray etag;
+    };
+
+    // Per-connection HTTP state while the socket is in request/response
+    // mode. SSE and WebSocket sockets are detached from it.
+    struct Connection {
+        HttpRequestParser parser;
+        QTimer* idleTimer = nullptr;
+        bool waiting = false;   // an answer is being prepared on another thread
+    };
+
+    // Answer to a query run on another thread; JSON for status 200,
+    // plain text otherwise.
+    struct Reply {
+        int status = 200;
+        QByteArray body;
+    };
+
+    bool listen();
+    void shutdown();
+    void processRequests(QTcpSocket* socket);
+    void handleRequest(QTcpSocket* socket, const HttpRequest& request);
+    void sendResponse(QTcpSocket* socket, const HttpRequest& request, int status,
+                      const QByteArray& contentType, const QByteArray& body,
+                      const QByteArray& extraHeaders = QByteArray());
+    void sendError(QTcpSocket* socket, int status);
+    void writeToClient(QTcpSocket* client, const QByteArray& data);
+    void addPushClient(QTcpSocket* client);
+    void removePushClient(QTcpSocket* client);
+    bool admitFrame(QTcpSocket* client);
+    void evictStalled(QTcpSocket* client);
+    void onClientDrained(QTcpSocket* client);
+    QByteArray detachConnection(QTcpSocket* socket);
+    void sendHtml(QTcpSocket* socket, const HttpRequest& request);
+    void sendJson(QTcpSocket* socket, const HttpRequest& request);
+    void sendKeys(QTcpSocket* socket, const HttpRequest& request);
+    void sendTransitions(QTcpSocket* socket, const HttpRequest& request);
+    void sendHistory(QTcpSocket* socket, const HttpRequest& request);
+    void sendRender(QTcpSocket* socket, const HttpRequest& request);
+    void sendSources(QTcpSocket* socket, const HttpRequest& request);
+    void sendLayout(QTcpSocket* socket, const HttpRequest& request);
+    void sendMetrics(QTcpSocket* socket, const HttpRequest& request);
+    void receiveLatency(QTcpSocket* socket, const HttpRequest& request);
+    void answerAsync(QObject* context, QTcpSocket* socket, const HttpRequest& request,
+                     std::function<Reply()> query);
+    static Reply renderHistory(const KeyStats& stats, const HistoryStore::Query& query);
+    static Reply renderTransitions(const TransitionStats& stats, int n);
+    static Reply renderSources(const HubServer& hub);
+    void sendCachedJson(QTcpSocket* socket, const HttpRequest& request, CachedJson& cache,
+                        QByteArray (*render)(const StatsSnapshot&));
+    static QByteArray renderStatsJson(const StatsSnapshot& stats);
+    static QByteArray renderKeysJson(const StatsSnapshot& stats);
     void sendSse(QTcpSocket* socket);
-    void broadcastSse();
-    void sendNotFound(QTcpSocket* socket);
-    QString getPressedKeysJson() const;
-    QString generateKeyboardJson() const;
+    void sendNotFound(QTcpSocket* socket, const HttpRequest& request);
+    void upgradeWebSocket(QTcpSocket* socket, const HttpRequest& request);
+    void onWebSocketData(QTcpSocket* socket);
+    QByteArray generateKeyboardJson() const;
+    void writeKeyboard(JsonWriter& json) const;
+    QByteArray generateLayoutJson() const;
+    QString renderHtml() const;
+    CachedPage buildPage() const;
+    void publishPage(PageEvent event);
+    void pushPageEvent(PageEvent event);
+
+    bool hasPushClients() const { return !m_sseClients.isEmpty() || !m_wsClients.isEmpty(); }
+    void updateKeyframeTimer();
+    void scheduleBroadcast();
+    void broadcast();
+    bool computeDelta(StateDelta& delta, const StatsSnapshot& stats);
+    StateDelta fullState() const;
+    const QByteArray& sseFrame(const StateDelta& delta);
+    QByteArray wsStatsFrame(const StateDelta& delta, quint8 fields) const;
+
+    static constexpr int MinBroadcastIntervalMs = 16;
+    static constexpr int KeyframeIntervalMs = 5000;
+    static constexpr int MaxWsMessageSize = 1024;
+    static constexpr int KeepAliveTimeoutMs = 15000;
+    static constexpr qint64 HighWaterBytes = 64 * 1024;
+    static constexpr qint64 LowWaterBytes = 16 * 1024;
+    static constexpr qint64 MaxStallMs = 30000;
 
+    QThread* m_thread = nullptr;
+    QMetaObject::Connection m_configConnection;
     QTcpServer* m_server = nullptr;
+    QHash<QTcpSocket*, Connection> m_connections;
+    QList<QTcpSocket*> m_sseClients;
+    QHash<QTcpSocket*, WsClient> m_wsClients;
+    QHash<QTcpSocket*, PushClient> m_pushClients;
+    BroadcastState m_sentState;
+    QByteArray m_sseBuffer;
+    quint64 m_seq = 0;
+    bool m_keyframeDue = false;
+    QTimer* m_broadcastTimer = nullptr;
+    QTimer* m_keyframeTimer = nullptr;
+    QElapsedTimer m_lastBroadcast;
     KeyStats* m_stats = nullptr;
     KeyLayout* m_layout = nullptr;
+    RenderScheduler* m_renderScheduler = nullptr;
+    HubServer* m_hub = nullptr;
+    CachedPage m_page;
+    CachedJson m_statsJson;
+    CachedJson m_keysJson;
+    QByteArray m_etagEpoch;
     quint16 m_port = 9863;
 };
 
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "hubclient.h"
+#include "hubprotocol.h"
+#include "metrics.h"
+#include <QDebug>
+
+HubClient::HubClient(QObject* parent)
+    : QObject(parent)
+{
+    m_socket = new QTcpSocket(this);
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(m_socket, &QTcpSocket::connected, this, &HubClient::onConnected);
+    connect(m_socket, &QTcpSocket::disconnected, this, &HubClient::onDisconnected);
+    connect(m_socket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+        if (m_socket->state() != QAbstractSocket::ConnectedState) {
+            onDisconnected();
+        }
+    });
+
+    // Both timers are only armed while there is something to do.
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(FlushIntervalMs);
+    connect(m_flushTimer, &QTimer::timeout, this, [this]() {
+        Metrics::instance()->add(Metrics::TimerWakeups);
+        flush();
+    });
+
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    m_reconnectTimer->setInterval(ReconnectIntervalMs);
+    connect(m_reconnectTimer, &QTimer::timeout, this, [this]() {
+        Metrics::instance()->add(Metrics::TimerWakeups);
+        if (m_active && m_socket->state() == QAbstractSocket::UnconnectedState) {
+            m_socket->connectToHost(m_host, m_port);
+        }
+    });
+
+    m_clock.start();
+}
+
+HubClient::~HubClient() {
+    disconnectFromHub();
+}
+
+bool HubClient::connectToHub(const QString& address) {
+    const int colon = address.lastIndexOf(':');
+    QString host = address;
+    quint16 port = HubProtocol::DefaultPort;
+    if (colon > 0) {
+        bool ok = false;
+        port = static_cast<quint16>(address.mid(colon + 1).toUInt(&ok));
+        if (!ok || port == 0) {
+            qWarning() << "Invalid hub address:" << address;
+            return false;
+        }
+        host = address.left(colon);
+    }
+    if (host.isEmpty()) {
+        qWarning() << "Invalid hub address:" << address;
+        return false;
+    }
+
+    m_host = host;
+    m_port = port;
+    m_active = true;
+    m_socket->abort();
+    m_socket->connectToHost(m_host, m_port);
+    return true;
+}
+
+void HubClient::disconnectFromHub() {
+    if (!m_active) return;
+    m_active = false;
+    m_reconnectTimer->stop();
+    if (isConnected()) {
+        flush();
+        m_socket->waitForBytesWritten(1000);
+        m_socket->disconnectFromHost();
+    } else {
+        m_socket->abort();
+    }
+}
+
+void HubClient::record(int vkCode, InputEvent::Type type, InputEvent::Source source) {
+    if (!isConnected()) {
+        ++m_dropped;
+        Metrics::instance()->add(Metrics::HubEventsDropped);
+        return;
+    }
+
+    InputEvent event;
+    event.time = static_cast<quint32>(m_clock.elapsed());
+    event.stamp = 0;
+    event.vkCode = static_cast<quint16>(vkCode);
+    event.type = type;
+    event.source = source;
+    HubProtocol::appendEvent(m_batch, event);
+
+    if (HubProtocol::eventCount(m_batch) >= MaxBatchEvents) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void HubClient::flush() {
+    m_flushTimer->stop();
+    if (m_batch.isEmpty()) return;
+
+    const int count = HubProtocol::eventCount(m_batch);
+    if (!isConnected() || m_socket->bytesToWrite() > MaxQueuedBytes) {
+        // The hub is not keeping up; losing events beats growing without bound.
+        m_dropped += static_cast<quint64>(count);
+        Metrics::instance()->add(Metrics::HubEventsDropped, static_cast<quint64>(count));
+    } else {
+        m_socket->write(HubProtocol::encodeFrame(HubProtocol::Events, m_batch));
+        m_sent += static_cast<quint64>(count);
+        Metrics::instance()->add(Metrics::HubEventsSent, static_cast<quint64>(count));
+    }
+    m_batch.resize(0);
+}
+
+void HubClient::onConnected() {
+    qDebug() << "Connected to hub" << m_host << m_port << "as" << m_name;
+    m_socket->write(HubProtocol::encodeFrame(HubProtocol::Hello, HubProtocol::encodeHello(m_name)));
+}
+
+void HubClient::onDisconnected() {
+    m_flushTimer->stop();
+    m_batch.resize(0);
+    if (m_active && !m_reconnectTimer->isActive()) {
+        m_reconnectTimer->start();
+    }
+}
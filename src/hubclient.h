@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HUBCLIENT_H
+#define HUBCLIENT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "inputevent.h"
+
+// Node side of hub mode: forwards this instance's input events to an
+// aggregator. Events are batched for up to FlushIntervalMs or MaxBatchEvents
+// and written as one frame. While the hub is unreachable, or the socket has
+// more than MaxQueuedBytes pending, events are dropped and the connection
+// is retried every ReconnectIntervalMs.
+class HubClient : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int FlushIntervalMs = 10;
+    static constexpr int MaxBatchEvents = 512;
+    static constexpr int ReconnectIntervalMs = 2000;
+    static constexpr qint64 MaxQueuedBytes = 256 * 1024;
+
+    explicit HubClient(QObject* parent = nullptr);
+    ~HubClient() override;
+
+    void setName(const QString& name) { m_name = name; }
+    QString name() const { return m_name; }
+
+    // "host" or "host:port"; the port defaults to HubProtocol::DefaultPort.
+    bool connectToHub(const QString& address);
+    // Sends what is batched and closes the connection.
+    void disconnectFromHub();
+
+    bool isConnected() const { return m_socket->state() == QAbstractSocket::ConnectedState; }
+    quint64 eventsSent() const { return m_sent; }
+    quint64 eventsDropped() const { return m_dropped; }
+
+    void record(int vkCode, InputEvent::Type type, InputEvent::Source source);
+
+private:
+    void flush();
+    void onConnected();
+    void onDisconnected();
+
+    QTcpSocket* m_socket = nullptr;
+    QTimer* m_flushTimer = nullptr;
+    QTimer* m_reconnectTimer = nullptr;
+    QElapsedTimer m_clock;
+    QString m_name;
+    QString m_host;
+    quint16 m_port = 0;
+    bool m_active = false;
+    QByteArray m_batch;
+    quint64 m_sent = 0;
+    quint64 m_dropped = 0;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "hubprotocol.h"
+#include <QtEndian>
+
+namespace HubProtocol {
+
+namespace {
+
+const char Magic[4] = { 'K', 'S', 'H', 'B' };
+
+}
+
+QByteArray encodeFrame(FrameType type, const QByteArray& payload) {
+    QByteArray frame;
+    frame.reserve(HeaderSize + payload.size());
+    frame.append(static_cast<char>(type));
+    char length[4];
+    qToBigEndian(static_cast<quint32>(payload.size()), length);
+    frame.append(length, 4);
+    frame.append(payload);
+    return frame;
+}
+
+QByteArray encodeHello(const QString& name) {
+    QByteArray payload(Magic, 4);
+    payload.append(static_cast<char>(Version));
+    payload.append(name.toUtf8().left(MaxNameSize));
+    return payload;
+}
+
+bool decodeHello(const QByteArray& payload, QString& name) {
+    if (payload.size() < 5 || payload.size() > 5 + MaxNameSize
+        || !payload.startsWith(QByteArray::fromRawData(Magic, 4))
+        || static_cast<quint8>(payload[4]) != Version) {
+        return false;
+    }
+    name = QString::fromUtf8(payload.mid(5)).trimmed();
+    return true;
+}
+
+void appendEvent(QByteArray& payload, const InputEvent& event) {
+    char data[EventSize];
+    qToLittleEndian(event.time, data);
+    qToLittleEndian(event.vkCode, data + 4);
+    data[6] = static_cast<char>(event.type);
+    data[7] = static_cast<char>(event.source);
+    payload.append(data, EventSize);
+}
+
+int eventCount(const QByteArray& payload) {
+    return payload.size() / EventSize;
+}
+
+InputEvent eventAt(const QByteArray& payload, int index) {
+    const char* data = payload.constData() + index * EventSize;
+    InputEvent event;
+    event.time = qFromLittleEndian<quint32>(data);
+    event.stamp = 0;
+    event.vkCode = qFromLittleEndian<quint16>(data + 4);
+    event.type = static_cast<quint8>(data[6]);
+    event.source = static_cast<quint8>(data[7]);
+    return event;
+}
+
+DecodeResult decodeFrame(QByteArray& buffer, Frame& frame) {
+    if (buffer.size() < HeaderSize) {
+        return Incomplete;
+    }
+    const quint8 type = static_cast<quint8>(buffer[0]);
+    const quint32 length = qFromBigEndian<quint32>(buffer.constData() + 1);
+    if ((type != Hello && type != Events) || length > static_cast<quint32>(MaxPayload)
+        || (type == Events && length % EventSize != 0)) {
+        return ProtocolError;
+    }
+    if (buffer.size() < HeaderSize + static_cast<int>(length)) {
+        return Incomplete;
+    }
+
+    frame.type = type;
+    frame.payload = buffer.mid(HeaderSize, static_cast<int>(length));
+    buffer.remove(0, HeaderSize + static_cast<int>(length));
+    return Decoded;
+}
+
+}
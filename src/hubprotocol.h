@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HUBPROTOCOL_H
+#define HUBPROTOCOL_H
+
+#include <QByteArray>
+#include <QString>
+#include "inputevent.h"
+
+// Framing between hub nodes and the aggregator. A node opens a TCP
+// connection, sends one Hello frame naming itself and then Events frames,
+// each carrying a batch of input events.
+//
+// Frame:  u8 type, u32 payload length (big-endian), payload
+// Hello:  "KSHB", u8 version, UTF-8 source name (at most MaxNameSize bytes)
+// Events: n x (u32 time, u16 vkCode, u8 type, u8 source), little-endian;
+//         time is the node's monotonic clock in ms
+namespace HubProtocol {
+
+enum FrameType : quint8 {
+    Hello = 1,
+    Events = 2
+};
+
+constexpr quint16 DefaultPort = 9877;
+constexpr quint8 Version = 1;
+constexpr int HeaderSize = 5;
+constexpr int EventSize = 8;
+constexpr int MaxNameSize = 64;
+constexpr int MaxPayload = 64 * 1024;
+
+struct Frame {
+    quint8 type = 0;
+    QByteArray payload;
+};
+
+enum DecodeResult {
+    Incomplete,
+    Decoded,
+    ProtocolError
+};
+
+QByteArray encodeFrame(FrameType type, const QByteArray& payload);
+QByteArray encodeHello(const QString& name);
+bool decodeHello(const QByteArray& payload, QString& name);
+
+void appendEvent(QByteArray& payload, const InputEvent& event);
+int eventCount(const QByteArray& payload);
+// index must be below eventCount(payload). The stamp is not transmitted.
+InputEvent eventAt(const QByteArray& payload, int index);
+
+// Removes one complete frame from the front of buffer.
+DecodeResult decodeFrame(QByteArray& buffer, Frame& frame);
+
+}
+
+#endif
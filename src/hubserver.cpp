@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "hubserver.h"
+#include "metrics.h"
+#include <QDebug>
+
+HubServer::HubServer(KeyStats* stats, QObject* parent)
+    : QObject(parent)
+    , m_stats(stats)
+{
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &HubServer::onNewConnection);
+    m_sources.reserve(MaxSources);
+    m_clock.start();
+}
+
+bool HubServer::listen(quint16 port, const QHostAddress& address) {
+    if (m_server->listen(address, port)) {
+        qDebug() << "Hub listening on port" << m_server->serverPort();
+        return true;
+    }
+    qWarning() << "Hub failed to listen on port" << port << ":" << m_server->errorString();
+    return false;
+}
+
+void HubServer::close() {
+    m_server->close();
+    const QList<QTcpSocket*> sockets = m_connections.keys();
+    for (QTcpSocket* socket : sockets) {
+        socket->abort();
+    }
+}
+
+qint64 HubServer::now() const {
+    return m_stats ? m_stats->now() : m_clock.elapsed();
+}
+
+int HubServer::connectedSources() const {
+    int count = 0;
+    for (const Source& source : m_sources) {
+        count += source.connected ? 1 : 0;
+    }
+    return count;
+}
+
+void HubServer::onNewConnection() {
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        m_connections.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() { onDisconnected(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void HubServer::onReadyRead(QTcpSocket* socket) {
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) return;
+    it->buffer.append(socket->readAll());
+
+    HubProtocol::Frame frame;
+    for (;;) {
+        const HubProtocol::DecodeResult result = HubProtocol::decodeFrame(it->buffer, frame);
+        if (result == HubProtocol::Incomplete) {
+            return;
+        }
+        if (result == HubProtocol::ProtocolError || !handleFrame(socket, *it, frame)) {
+            qWarning() << "Hub protocol error from" << socket->peerAddress().toString();
+            socket->abort();
+            return;
+        }
+    }
+}
+
+bool HubServer::handleFrame(QTcpSocket* socket, Connection& connection, const HubProtocol::Frame& frame) {
+    if (frame.type == HubProtocol::Hello) {
+        QString name;
+        if (connection.source >= 0 || !HubProtocol::decodeHello(frame.payload, name)) {
+            return false;
+        }
+        connection.source = bindSource(name, socket->peerAddress().toString());
+        if (connection.source < 0) {
+            return false;
+        }
+        emit sourcesChanged();
+        return true;
+    }
+
+    // Events before Hello have no source to be tagged with.
+    if (connection.source < 0) {
+        return false;
+    }
+    Source& source = m_sources[connection.source];
+    const int count = HubProtocol::eventCount(frame.payload);
+    const qint64 arrivalMs = now();
+    for (int i = 0; i < count; ++i) {
+        const InputEvent event = HubProtocol::eventAt(frame.payload, i);
+        applyEvent(source, event, mapTime(source, event.time, arrivalMs));
+    }
+    source.events += static_cast<quint64>(count);
+    ++source.batches;
+    source.lastSeen.restart();
+    Metrics::instance()->add(Metrics::HubEventsReceived, static_cast<quint64>(count));
+    return true;
+}
+
+// Reuses the entry of a disconnected source with the same name; a name that
+// is already connected gets a numeric suffix.
+int HubServer::bindSource(const QString& name, const QString& address) {
+    const QString base = name.isEmpty() ? address : name;
+    QString candidate = base;
+    for (int suffix = 2;; ++suffix) {
+        int index = -1;
+        for (int i = 0; i < m_sources.size(); ++i) {
+            if (m_sources[i].name == candidate) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) {
+            if (m_sources.size() >= MaxSources) {
+                qWarning() << "Hub source limit reached, rejecting" << candidate;
+                return -1;
+            }
+            Source source;
+            source.name = candidate;
+            m_sources.append(source);
+            index = m_sources.size() - 1;
+        } else if (m_sources[index].connected) {
+            candidate = base + "#" + QString::number(suffix);
+            continue;
+        }
+
+        Source& source = m_sources[index];
+        source.address = address;
+        source.connected = true;
+        source.clockSynced = false;
+        source.lastSeen.start();
+        qDebug() << "Hub source connected:" << source.name << "from" << address;
+        return index;
+    }
+}
+
+// The offset is the smallest arrival-minus-send difference seen, i.e. the
+// node clock shifted by the fastest delivery, so batching delay drops out.
+// It may grow by 1 ms per second of node time to follow a node clock that
+// runs slow; a fast one lowers the minimum by itself.
+qint64 HubServer::mapTime(Source& source, quint32 nodeTime, qint64 arrivalMs) {
+    if (!source.clockSynced) {
+        source.clockSynced = true;
+        source.nodeMs = nodeTime;
+        source.clockOffsetMs = static_cast<double>(arrivalMs - source.nodeMs);
+    } else {
+        const quint32 elapsed = nodeTime - source.lastNodeTime;
+        source.nodeMs += elapsed;
+        source.clockOffsetMs = qMin(source.clockOffsetMs + elapsed * 0.001,
+                                    static_cast<double>(arrivalMs - source.nodeMs));
+    }
+    source.lastNodeTime = nodeTime;
+
+    const qint64 timeMs = source.nodeMs + static_cast<qint64>(source.clockOffsetMs);
+    source.lastEventMs = qBound(source.lastEventMs, timeMs, arrivalMs);
+    return source.lastEventMs;
+}
+
+void HubServer::applyEvent(Source& source, const InputEvent& event, qint64 timeMs) {
+    const int vk = event.vkCode;
+    if (!VkBitmap::isValid(vk)) return;
+
+    if (event.type == InputEvent::Press) {
+        source.keyCounts.increment(vk);
+        ++source.totalKeyPresses;
+        source.kps.record(timeMs);
+        if (!source.pressedKeys.contains(vk)) {
+            source.pressedKeys.insert(vk);
+            ++m_holders[vk];
+        }
+        if (m_stats) {
+            m_stats->recordKeyPressAt(vk, timeMs);
+        }
+    } else if (event.type == InputEvent::Release && source.pressedKeys.contains(vk)) {
+        source.pressedKeys.remove(vk);
+        if (--m_holders[vk] == 0 && m_stats) {
+            m_stats->recordKeyReleaseAt(vk, timeMs);
+        }
+    }
+}
+
+// Keys held by a node that went away would otherwise stay down forever.
+// They are released when the hub notices, as nothing later was stamped.
+void HubServer::releaseAll(Source& source) {
+    const qint64 timeMs = now();
+    const VkBitmap held = source.pressedKeys;
+    for (int vk : held) {
+        InputEvent release = {};
+        release.vkCode = static_cast<quint16>(vk);
+        release.type = InputEvent::Release;
+        applyEvent(source, release, timeMs);
+    }
+}
+
+void HubServer::onDisconnected(QTcpSocket* socket) {
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) return;
+    if (it->source >= 0) {
+        Source& source = m_sources[it->source];
+        source.connected = false;
+        releaseAll(source);
+        qDebug() << "Hub source disconnected:" << source.name;
+    }
+    m_connections.erase(it);
+    emit sourcesChanged();
+}
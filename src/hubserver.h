@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HUBSERVER_H
+#define HUBSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include "keystats.h"
+#include "hubprotocol.h"
+
+// Aggregator side of hub mode: accepts HubClient connections and merges
+// their events into one KeyStats, so the overlay and /api/stats show every
+// node combined, while keeping per-source counters for /api/sources.
+// Lives on the thread of the KeyStats it feeds.
+//
+// Events are merged at the time the node stamped them, mapped onto the
+// hub's clock with a per-source offset, so batching and network delay do
+// not distort rates and hold times. There is no authentication: the hub
+// listens on localhost unless given another address.
+//
+// Sources are identified by the name in their Hello frame; a node that
+// reconnects under the same name continues its counters. A key counts as
+// held in the combined stats while any source holds it.
+class HubServer : public QObject {
+    Q_OBJECT
+
+public:
+    struct Source {
+        QString name;
+        QString address;
+        bool connected = false;
+        quint64 events = 0;
+        quint64 batches = 0;
+        int totalKeyPresses = 0;
+        KeyCounts keyCounts;
+        VkBitmap pressedKeys;
+        KpsMeter kps;
+        QElapsedTimer lastSeen;     // since the last frame
+        // Node clock mapping, restarted on every connection.
+        bool clockSynced = false;
+        quint32 lastNodeTime = 0;   // as sent, wraps after 49 days
+        qint64 nodeMs = 0;          // unwrapped
+        double clockOffsetMs = 0;   // hub time minus node time
+        qint64 lastEventMs = 0;     // mapped time of the latest event
+    };
+
+    explicit HubServer(KeyStats* stats, QObject* parent = nullptr);
+
+    bool listen(quint16 port = HubProtocol::DefaultPort, const QHostAddress& address = QHostAddress::LocalHost);
+    void close();
+    quint16 port() const { return m_server->serverPort(); }
+
+    const QVector<Source>& sources() const { return m_sources; }
+    int connectedSources() const;
+    // Milliseconds on the hub's clock, for reading Source::kps. This is the
+    // clock of the KeyStats when there is one.
+    qint64 now() const;
+
+signals:
+    void sourcesChanged();
+
+private:
+    // A connection is bound to a source once its Hello frame arrived.
+    struct Connection {
+        QByteArray buffer;
+        int source = -1;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket* socket);
+    void onDisconnected(QTcpSocket* socket);
+    bool handleFrame(QTcpSocket* socket, Connection& connection, const HubProtocol::Frame& frame);
+    int bindSource(const QString& name, const QString& address);
+    qint64 mapTime(Source& source, quint32 nodeTime, qint64 arrivalMs);
+    void applyEvent(Source& source, const InputEvent& event, qint64 timeMs);
+    void releaseAll(Source& source);
+
+    static constexpr int MaxSources = 64;
+
+    KeyStats* m_stats = nullptr;
+    QTcpServer* m_server = nullptr;
+    QHash<QTcpSocket*, Connection> m_connections;
+    QVector<Source> m_sources;
+    quint8 m_holders[VkBitmap::Size] = {};   // sources holding each key
+    QElapsedTimer m_clock;
+};
+
+#endif
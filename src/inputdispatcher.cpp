@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "inputdispatcher.h"
+#include "latency.h"
+#include "metrics.h"
+
+InputDispatcher::InputDispatcher(QObject* parent)
+    : QObject(parent)
+{
+}
+
+bool InputDispatcher::push(const InputEvent& event) {
+    if (!tryPush(event)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        Metrics::instance()->add(Metrics::EventsDropped);
+        return false;
+    }
+    return true;
+}
+
+bool InputDispatcher::tryPush(const InputEvent& event) {
+    if (!m_ring.push(event)) {
+        return false;
+    }
+
+    // Pairs with the fence in drain(): either the consumer sees this event,
+    // or we see the cleared flag and post a new wake-up.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!m_wakePending.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, &InputDispatcher::drain, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void InputDispatcher::drain() {
+    m_wakePending.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    int count = static_cast<int>(m_ring.drain([this](const InputEvent& event) {
+        dispatch(event);
+    }, BatchSize));
+
+    if (count == BatchSize && !m_ring.isEmpty()) {
+        // Yield to the event loop between batches so painting keeps up.
+        if (!m_wakePending.exchange(true, std::memory_order_acq_rel)) {
+            QMetaObject::invokeMethod(this, &InputDispatcher::drain, Qt::QueuedConnection);
+        }
+    }
+
+    if (count > 0) {
+        Metrics::instance()->add(Metrics::EventsIngested, static_cast<quint64>(count));
+        emit batchProcessed(count);
+    }
+}
+
+void InputDispatcher::dispatch(const InputEvent& event) {
+    const int vkCode = event.vkCode;
+    Latency::instance()->setCurrentEvent(event.stamp);
+    switch (event.type) {
+    case InputEvent::Press:
+        if (event.source == InputEvent::Mouse) {
+            emit buttonPressed(vkCode);
+        } else {
+            emit keyPressed(vkCode);
+        }
+        break;
+    case InputEvent::Release:
+        if (event.source == InputEvent::Mouse) {
+            emit buttonReleased(vkCode);
+        } else {
+            emit keyReleased(vkCode);
+        }
+        break;
+    case InputEvent::WheelUp:
+        emit wheelScrolled(1);
+        break;
+    case InputEvent::WheelDown:
+        emit wheelScrolled(-1);
+        break;
+    }
+    // Not ingested (filtered out, or a wheel event): nothing to trace.
+    Latency::instance()->clearCurrentEvent();
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef INPUTDISPATCHER_H
+#define INPUTDISPATCHER_H
+
+#include <QObject>
+#include <atomic>
+#include "inputevent.h"
+#include "eventring.h"
+
+// Hands input events from the hook thread (producer) to the thread this
+// object lives on (consumer). push() is wait-free and only posts a wake-up
+// when the consumer is idle; the consumer drains queued events in batches.
+class InputDispatcher : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int RingCapacity = 8192;
+    static constexpr int BatchSize = 512;
+
+    explicit InputDispatcher(QObject* parent = nullptr);
+
+    // Producer side, callable from exactly one thread at a time. push()
+    // counts a full ring as a dropped event; tryPush() leaves retrying to
+    // the caller.
+    bool push(const InputEvent& event);
+    bool tryPush(const InputEvent& event);
+
+    int pendingEvents() const { return static_cast<int>(m_ring.size()); }
+    quint64 droppedEvents() const { return m_dropped.load(std::memory_order_relaxed); }
+
+signals:
+    void keyPressed(int vkCode);
+    void keyReleased(int vkCode);
+    void buttonPressed(int vkCode);
+    void buttonReleased(int vkCode);
+    void wheelScrolled(int delta);
+    void batchProcessed(int count);
+
+public slots:
+    void drain();
+
+private:
+    void dispatch(const InputEvent& event);
+
+    EventRing<InputEvent, RingCapacity> m_ring;
+    std::atomic<bool> m_wakePending{false};
+    std::atomic<quint64> m_dropped{0};
+};
+
+#endif
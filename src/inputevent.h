@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef INPUTEVENT_H
+#define INPUTEVENT_H
+
+#include <QtGlobal>
+
+struct InputEvent {
+    enum Type : quint8 {
+        Press,
+        Release,
+        WheelUp,
+        WheelDown
+    };
+
+    enum Source : quint8 {
+        Keyboard,
+        Mouse
+    };
+
+    quint32 time;       // KBDLLHOOKSTRUCT::time / MSLLHOOKSTRUCT::time (ms)
+    quint32 stamp;      // Latency::stamp() at hook entry (us)
+    quint16 vkCode;
+    quint8 type;
+    quint8 source;
+};
+
+static_assert(sizeof(InputEvent) == 12, "InputEvent must stay compact");
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef INPUTSOURCE_H
+#define INPUTSOURCE_H
+
+#include <QObject>
+#include "inputdispatcher.h"
+
+// A producer of input events. Implementations push into an InputDispatcher
+// from a single thread of their choosing; the dispatcher delivers them on
+// its own thread.
+class InputSource : public QObject {
+    Q_OBJECT
+
+public:
+    explicit InputSource(QObject* parent = nullptr);
+    ~InputSource() override;
+
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+
+    void setDispatcher(InputDispatcher* dispatcher) { m_dispatcher = dispatcher; }
+    InputDispatcher* dispatcher() const { return m_dispatcher; }
+
+protected:
+    bool post(const InputEvent& event) {
+        return m_dispatcher ? m_dispatcher->push(event) : false;
+    }
+
+    InputDispatcher* m_dispatcher = nullptr;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "jsonwriter.h"
+#include <cmath>
+
+JsonWriter& JsonWriter::beginObject() {
+    separate();
+    m_out.append('{');
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    m_out.append('}');
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separate();
+    m_out.append('[');
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    m_out.append(']');
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+    separate();
+    m_out.append('"');
+    m_out.append(name);
+    m_out.append("\":", 2);
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(int name) {
+    separate();
+    m_out.append('"');
+    appendInteger(m_out, static_cast<qint64>(name));
+    m_out.append("\":", 2);
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(qint64 v) {
+    separate();
+    appendInteger(m_out, v);
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(quint64 v) {
+    separate();
+    appendInteger(m_out, v);
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double v) {
+    separate();
+    m_needComma = true;
+    if (!std::isfinite(v)) {
+        m_out.append("null", 4);
+        return *this;
+    }
+    // Fixed point in thousandths; out of that range fall back to Qt's
+    // (locale independent) formatting.
+    if (std::fabs(v) >= 1e15) {
+        m_out.append(QByteArray::number(v, 'g', 17));
+        return *this;
+    }
+
+    qint64 scaled = qRound64(v * 1000.0);
+    if (scaled < 0) {
+        m_out.append('-');
+        scaled = -scaled;
+    }
+    appendInteger(m_out, static_cast<quint64>(scaled / 1000));
+    int fraction = static_cast<int>(scaled % 1000);
+    if (fraction != 0) {
+        char digits[4] = { '.', char('0' + fraction / 100), char('0' + fraction / 10 % 10), char('0' + fraction % 10) };
+        int length = 4;
+        while (digits[length - 1] == '0') {
+            --length;
+        }
+        m_out.append(digits, length);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool v) {
+    separate();
+    if (v) {
+        m_out.append("true", 4);
+    } else {
+        m_out.append("false", 5);
+    }
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const QString& v) {
+    separate();
+    appendString(m_out, v.toUtf8());
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separate();
+    m_out.append("null", 4);
+    m_needComma = true;
+    return *this;
+}
+
+void JsonWriter::appendInteger(QByteArray& out, quint64 v) {
+    char buffer[20];
+    char* end = buffer + sizeof(buffer);
+    char* p = end;
+    do {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    out.append(p, static_cast<int>(end - p));
+}
+
+void JsonWriter::appendInteger(QByteArray& out, qint64 v) {
+    if (v < 0) {
+        out.append('-');
+        appendInteger(out, static_cast<quint64>(0) - static_cast<quint64>(v));
+    } else {
+        appendInteger(out, static_cast<quint64>(v));
+    }
+}
+
+// '<' is escaped as well so strings can be embedded in an HTML <script>.
+void JsonWriter::appendString(QByteArray& out, const QByteArray& utf8) {
+    static const char hex[] = "0123456789abcdef";
+
+    out.append('"');
+    for (char ch : utf8) {
+        const quint8 c = static_cast<quint8>(ch);
+        switch (c) {
+        case '"': out.append("\\\"", 2); break;
+        case '\\': out.append("\\\\", 2); break;
+        case '\n': out.append("\\n", 2); break;
+        case '\r': out.append("\\r", 2); break;
+        case '\t': out.append("\\t", 2); break;
+        default:
+            if (c < 0x20 || c == '<') {
+                const char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                out.append(escape, 6);
+            } else {
+                out.append(ch);
+            }
+        }
+    }
+    out.append('"');
+}
+
+void JsonWriter::separate() {
+    if (m_needComma) {
+        m_out.append(',');
+    }
+}
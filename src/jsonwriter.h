@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <QByteArray>
+#include <QString>
+
+// Streaming JSON writer that appends straight into a caller-owned
+// QByteArray, so a reused buffer serializes without any intermediate DOM
+// or QString round trip. Nesting is not validated; callers write keys and
+// values in order and the writer only takes care of commas and escaping.
+class JsonWriter {
+public:
+    explicit JsonWriter(QByteArray& out) : m_out(out) {}
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    // Keys given as const char* must be plain ASCII that needs no escaping.
+    JsonWriter& key(const char* name);
+    // Numeric object key, written as a quoted string ("65").
+    JsonWriter& key(int name);
+
+    JsonWriter& value(int v) { return value(static_cast<qint64>(v)); }
+    JsonWriter& value(qint64 v);
+    JsonWriter& value(quint64 v);
+    // Written with at most three decimals; NaN and infinity become null.
+    JsonWriter& value(double v);
+    JsonWriter& value(bool v);
+    JsonWriter& value(const QString& v);
+    JsonWriter& null();
+
+    static void appendInteger(QByteArray& out, qint64 v);
+    static void appendInteger(QByteArray& out, quint64 v);
+    static void appendString(QByteArray& out, const QByteArray& utf8);
+
+private:
+    void separate();
+
+    QByteArray& m_out;
+    bool m_needComma = false;
+};
+
+#endif
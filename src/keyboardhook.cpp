@@ -15,12 +15,21 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "keyboardhook.h"
+#include "latency.h"
+#include "metrics.h"
 #include <QDebug>
 
-KeyboardHook* KeyboardHook::s_instance = nullptr;
+thread_local KeyboardHook* KeyboardHook::s_instance = nullptr;
+
+// Traced only for events that are posted, so the histogram describes the
+// presses and releases the overlay shows.
+static void recordDelivery(DWORD eventTime) {
+    Latency::instance()->recordUs(Latency::HookDelivery,
+        static_cast<quint64>(static_cast<quint32>(GetTickCount() - eventTime)) * 1000);
+}
 
 KeyboardHook::KeyboardHook(QObject* parent)
-    : QObject(parent)
+    : InputSource(parent)
 {
     s_instance = this;
 }
@@ -58,15 +67,25 @@ void KeyboardHook::stop() {
 LRESULT CALLBACK KeyboardHook::lowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode == HC_ACTION) {
         if (s_instance) {
+            const qint64 startNs = Metrics::now();
+            const quint32 stamp = Latency::stamp();
             KBDLLHOOKSTRUCT* pKeyboard = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
             int vkCode = static_cast<int>(pKeyboard->vkCode);
 
+            InputEvent event;
+            event.time = pKeyboard->time;
+            event.stamp = stamp;
+            event.vkCode = static_cast<quint16>(vkCode);
+            event.source = InputEvent::Keyboard;
+
             switch (wParam) {
             case WM_KEYDOWN:
             case WM_SYSKEYDOWN:
                 if (!s_instance->m_pressedKeys.contains(vkCode)) {
                     s_instance->m_pressedKeys.insert(vkCode);
-                    emit s_instance->keyPressed(vkCode);
+                    event.type = InputEvent::Press;
+                    recordDelivery(pKeyboard->time);
+                    s_instance->post(event);
                 }
                 break;
 
@@ -74,10 +93,13 @@ LRESULT CALLBACK KeyboardHook::lowLevelKeyboardProc(int nCode, WPARAM wParam, LP
             case WM_SYSKEYUP:
                 if (s_instance->m_pressedKeys.contains(vkCode)) {
                     s_instance->m_pressedKeys.remove(vkCode);
-                    emit s_instance->keyReleased(vkCode);
+                    event.type = InputEvent::Release;
+                    recordDelivery(pKeyboard->time);
+                    s_instance->post(event);
                 }
                 break;
             }
+            Metrics::instance()->timing(Metrics::HookCallback, startNs);
         }
     }
     return CallNextHookEx(nullptr, nCode, wParam, lParam);
@@ -18,33 +18,31 @@
 #define KEYBOARDHOOK_H
 
 #include <QObject>
-#include <QSet>
 #include <windows.h>
+#include "inputsource.h"
+#include "vkbitmap.h"
 
-class KeyboardHook : public QObject {
+class KeyboardHook : public InputSource {
     Q_OBJECT
 
 public:
     explicit KeyboardHook(QObject* parent = nullptr);
     ~KeyboardHook();
 
-    bool start();
-    void stop();
+    bool start() override;
+    void stop() override;
 
-    const QSet<int>& pressedKeys() const { return m_pressedKeys; }
-
-signals:
-    void keyPressed(int vkCode);
-    void keyReleased(int vkCode);
+    const VkBitmap& pressedKeys() const { return m_pressedKeys; }
 
 private:
     static LRESULT CALLBACK lowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
 
     HHOOK m_hook = nullptr;
-    QSet<int> m_pressedKeys;
+    VkBitmap m_pressedKeys;
     bool m_running = false;
 
-    static KeyboardHook* s_instance;
+    // Low-level hooks are called on the thread that installed them.
+    static thread_local KeyboardHook* s_instance;
 };
 
 #endif
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef KEYCOUNTS_H
+#define KEYCOUNTS_H
+
+#include "vkbitmap.h"
+
+// Press counters indexed directly by virtual-key code. Iteration visits only
+// keys that have been pressed, in ascending vk order, with the same
+// key()/value() accessors as the QMap it replaces.
+class KeyCounts {
+public:
+    class const_iterator {
+    public:
+        const_iterator(VkBitmap::const_iterator it, const int* counts)
+            : m_it(it)
+            , m_counts(counts)
+        {
+        }
+
+        int key() const { return *m_it; }
+        int value() const { return m_counts[*m_it]; }
+        int operator*() const { return value(); }
+
+        const_iterator& operator++() {
+            ++m_it;
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const { return m_it == other.m_it; }
+        bool operator!=(const const_iterator& other) const { return m_it != other.m_it; }
+
+    private:
+        VkBitmap::const_iterator m_it;
+        const int* m_counts;
+    };
+
+    int value(int vkCode) const { return m_touched.contains(vkCode) ? m_counts[vkCode] : 0; }
+    bool contains(int vkCode) const { return m_touched.contains(vkCode); }
+    int size() const { return m_touched.count(); }
+    bool isEmpty() const { return m_touched.isEmpty(); }
+    const VkBitmap& keys() const { return m_touched; }
+
+    // vkCode must already be range-checked.
+    void increment(int vkCode) {
+        ++m_counts[vkCode];
+        m_touched.insert(vkCode);
+    }
+
+    // Used when restoring persisted counters.
+    void set(int vkCode, int value) {
+        m_counts[vkCode] = value;
+        if (value != 0) {
+            m_touched.insert(vkCode);
+        } else {
+            m_touched.remove(vkCode);
+        }
+    }
+
+    void clear() {
+        for (int& count : m_counts) {
+            count = 0;
+        }
+        m_touched.clear();
+    }
+
+    const_iterator constBegin() const { return const_iterator(m_touched.begin(), m_counts); }
+    const_iterator constEnd() const { return const_iterator(m_touched.end(), m_counts); }
+    const_iterator begin() const { return constBegin(); }
+    const_iterator end() const { return constEnd(); }
+
+private:
+    alignas(64) int m_counts[VkBitmap::Size] = {};
+    VkBitmap m_touched;
+};
+
+#endif
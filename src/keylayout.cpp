@@ -15,11 +15,46 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "keylayout.h"
+#include "layoutcache.h"
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Compiled layout: CompiledHeader, keyCount CompiledKey records, the vk
+// offset table, the key indices, then the UTF-16 name and all labels.
+struct CompiledHeader {
+    qint32 unitWidth;
+    qint32 unitHeight;
+    qint32 keySpacing;
+    quint32 keyCount;
+    qint32 bounds[4];
+    quint32 nameChars;
+    quint32 labelChars;
+};
+
+struct CompiledKey {
+    qint32 vkCode;
+    qint32 geometry[4];
+    quint32 labelOffset;
+    quint32 labelChars;
+    quint32 reserved;
+    double row;
+    double col;
+    double width;
+    double height;
+};
+
+static_assert(sizeof(CompiledHeader) == 40, "compiled layout header size");
+static_assert(sizeof(CompiledKey) == 64, "compiled key size");
+static_assert(sizeof(int) == sizeof(qint32), "compiled index size");
+
+}
 
 KeyLayout::KeyLayout(QObject* parent)
     : QObject(parent)
@@ -39,13 +74,24 @@ bool KeyLayout::loadFromFile(const QString& filePath) {
     QByteArray data = file.readAll();
     file.close();
 
+    return loadFromData(data, filePath);
+}
+
+bool KeyLayout::loadFromCache(const QString& filePath) {
+    return LayoutCache::instance()->load(filePath, this);
+}
+
+bool KeyLayout::loadFromData(const QByteArray& data, const QString& filePath) {
     QJsonDocument doc = QJsonDocument::fromJson(data);
     if (doc.isNull() || !doc.isObject()) {
         qWarning() << "Invalid JSON format in layout file:" << filePath;
         return false;
     }
 
-    QJsonObject root = doc.object();
+    return loadFromJson(doc.object());
+}
+
+bool KeyLayout::loadFromJson(const QJsonObject& root) {
     m_name = root.value("name").toString("Unknown");
     m_unitWidth = root.value("unitWidth").toInt(40);
     m_unitHeight = root.value("unitHeight").toInt(40);
@@ -53,6 +99,7 @@ bool KeyLayout::loadFromFile(const QString& filePath) {
 
     QJsonArray keys = root.value("keys").toArray();
     m_keys.clear();
+    m_keys.reserve(static_cast<size_t>(keys.size()));
 
     for (const QJsonValue& keyValue : keys) {
         QJsonObject keyObj = keyValue.toObject();
@@ -64,31 +111,180 @@ bool KeyLayout::loadFromFile(const QString& filePath) {
         info.width = keyObj.value("width").toDouble(1);
         info.height = keyObj.value("height").toDouble(1);
 
+        if (!VkBitmap::isValid(info.vkCode)) {
+            qWarning() << "Skipping key with invalid vkCode" << info.vkCode << "in layout" << m_name;
+            continue;
+        }
+
         int x = static_cast<int>(info.col * (m_unitWidth + m_keySpacing));
         int y = static_cast<int>(info.row * (m_unitHeight + m_keySpacing));
         int w = static_cast<int>(info.width * m_unitWidth + (info.width - 1) * m_keySpacing);
         int h = static_cast<int>(info.height * m_unitHeight + (info.height - 1) * m_keySpacing);
         info.geometry = QRect(x, y, w, h);
 
-        m_keys.insert(info.vkCode, info);
+        m_keys.push_back(info);
     }
 
+    buildIndex();
     qDebug() << "Loaded layout:" << m_name << "with" << m_keys.size() << "keys";
     return true;
 }
 
-QRect KeyLayout::getKeyGeometry(int vkCode) const {
-    auto it = m_keys.find(vkCode);
-    if (it != m_keys.end()) {
-        return it.value().geometry;
+// Counting sort of the key indices by vk: m_vkOffsets[vk] .. [vk + 1] is the
+// slice of m_keyIndices for that vk, in layout order.
+void KeyLayout::buildIndex() {
+    int counts[VkBitmap::Size] = {};
+    m_vkCodes.clear();
+    m_bounds = QRect();
+    for (const KeyInfo& info : m_keys) {
+        ++counts[info.vkCode];
+        m_vkCodes.insert(info.vkCode);
+        m_bounds = m_bounds.united(info.geometry);
+    }
+
+    m_vkOffsets[0] = 0;
+    for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+        m_vkOffsets[vk + 1] = m_vkOffsets[vk] + counts[vk];
+    }
+
+    m_keyIndices.assign(m_keys.size(), 0);
+    int next[VkBitmap::Size];
+    std::copy(m_vkOffsets, m_vkOffsets + VkBitmap::Size, next);
+    for (int i = 0; i < static_cast<int>(m_keys.size()); ++i) {
+        m_keyIndices[next[m_keys[i].vkCode]++] = i;
     }
-    return QRect();
 }
 
-QString KeyLayout::getKeyLabel(int vkCode) const {
-    auto it = m_keys.find(vkCode);
-    if (it != m_keys.end()) {
-        return it.value().label;
+QByteArray KeyLayout::compiled() const {
+    quint32 labelChars = 0;
+    for (const KeyInfo& info : m_keys) {
+        labelChars += static_cast<quint32>(info.label.size());
+    }
+
+    CompiledHeader header = {};
+    header.unitWidth = m_unitWidth;
+    header.unitHeight = m_unitHeight;
+    header.keySpacing = m_keySpacing;
+    header.keyCount = static_cast<quint32>(m_keys.size());
+    header.bounds[0] = m_bounds.x();
+    header.bounds[1] = m_bounds.y();
+    header.bounds[2] = m_bounds.width();
+    header.bounds[3] = m_bounds.height();
+    header.nameChars = static_cast<quint32>(m_name.size());
+    header.labelChars = labelChars;
+
+    QByteArray data;
+    data.reserve(static_cast<int>(sizeof(header) + m_keys.size() * (sizeof(CompiledKey) + sizeof(int))
+                                  + sizeof(m_vkOffsets) + (header.nameChars + labelChars) * sizeof(char16_t)));
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    quint32 labelOffset = 0;
+    for (const KeyInfo& info : m_keys) {
+        CompiledKey key = {};
+        key.vkCode = info.vkCode;
+        key.geometry[0] = info.geometry.x();
+        key.geometry[1] = info.geometry.y();
+        key.geometry[2] = info.geometry.width();
+        key.geometry[3] = info.geometry.height();
+        key.labelOffset = labelOffset;
+        key.labelChars = static_cast<quint32>(info.label.size());
+        key.row = info.row;
+        key.col = info.col;
+        key.width = info.width;
+        key.height = info.height;
+        data.append(reinterpret_cast<const char*>(&key), sizeof(key));
+        labelOffset += key.labelChars;
     }
-    return QString();
+
+    data.append(reinterpret_cast<const char*>(m_vkOffsets), sizeof(m_vkOffsets));
+    data.append(reinterpret_cast<const char*>(m_keyIndices.data()),
+                static_cast<int>(m_keyIndices.size() * sizeof(int)));
+    data.append(reinterpret_cast<const char*>(m_name.utf16()), static_cast<int>(m_name.size() * sizeof(char16_t)));
+    for (const KeyInfo& info : m_keys) {
+        data.append(reinterpret_cast<const char*>(info.label.utf16()),
+                    static_cast<int>(info.label.size() * sizeof(char16_t)));
+    }
+    return data;
+}
+
+// The data may come from a file another version wrote or that was cut
+// short, so every count and index is checked before anything is replaced.
+bool KeyLayout::loadCompiled(const uchar* data, qint64 size) {
+    CompiledHeader header;
+    if (size < static_cast<qint64>(sizeof(header))) return false;
+    std::memcpy(&header, data, sizeof(header));
+
+    const qint64 keyCount = header.keyCount;
+    const qint64 offsetsPos = static_cast<qint64>(sizeof(header)) + keyCount * static_cast<qint64>(sizeof(CompiledKey));
+    const qint64 indicesPos = offsetsPos + static_cast<qint64>(sizeof(m_vkOffsets));
+    const qint64 textPos = indicesPos + keyCount * static_cast<qint64>(sizeof(int));
+    const qint64 textChars = static_cast<qint64>(header.nameChars) + header.labelChars;
+    if (textPos + textChars * static_cast<qint64>(sizeof(char16_t)) != size) return false;
+
+    int offsets[VkBitmap::Size + 1];
+    std::memcpy(offsets, data + offsetsPos, sizeof(offsets));
+    if (offsets[0] != 0 || offsets[VkBitmap::Size] != keyCount) return false;
+    for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+        if (offsets[vk + 1] < offsets[vk]) return false;
+    }
+
+    std::vector<int> indices(static_cast<size_t>(keyCount));
+    std::memcpy(indices.data(), data + indicesPos, indices.size() * sizeof(int));
+
+    // Copied rather than referenced: the text is not necessarily aligned.
+    QString text(static_cast<int>(textChars), Qt::Uninitialized);
+    std::memcpy(text.data(), data + textPos, static_cast<size_t>(textChars) * sizeof(char16_t));
+
+    std::vector<KeyInfo> keys;
+    keys.reserve(static_cast<size_t>(keyCount));
+    for (qint64 i = 0; i < keyCount; ++i) {
+        CompiledKey key;
+        std::memcpy(&key, data + sizeof(header) + i * static_cast<qint64>(sizeof(key)), sizeof(key));
+        if (!VkBitmap::isValid(key.vkCode)
+            || static_cast<qint64>(key.labelOffset) + key.labelChars > header.labelChars) {
+            return false;
+        }
+        KeyInfo info;
+        info.vkCode = key.vkCode;
+        info.label = text.mid(static_cast<int>(header.nameChars + key.labelOffset), static_cast<int>(key.labelChars));
+        info.geometry = QRect(key.geometry[0], key.geometry[1], key.geometry[2], key.geometry[3]);
+        info.row = key.row;
+        info.col = key.col;
+        info.width = key.width;
+        info.height = key.height;
+        keys.push_back(info);
+    }
+
+    VkBitmap vkCodes;
+    for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+        for (int slot = offsets[vk]; slot < offsets[vk + 1]; ++slot) {
+            const int index = indices[static_cast<size_t>(slot)];
+            if (index < 0 || index >= keyCount || keys[static_cast<size_t>(index)].vkCode != vk) return false;
+        }
+        if (offsets[vk + 1] > offsets[vk]) {
+            vkCodes.insert(vk);
+        }
+    }
+
+    m_name = text.left(static_cast<int>(header.nameChars));
+    m_unitWidth = header.unitWidth;
+    m_unitHeight = header.unitHeight;
+    m_keySpacing = header.keySpacing;
+    m_keys.swap(keys);
+    std::copy(offsets, offsets + VkBitmap::Size + 1, m_vkOffsets);
+    m_keyIndices.swap(indices);
+    m_vkCodes = vkCodes;
+    m_bounds = QRect(header.bounds[0], header.bounds[1], header.bounds[2], header.bounds[3]);
+    qDebug() << "Loaded compiled layout:" << m_name << "with" << m_keys.size() << "keys";
+    return true;
+}
+
+QRect KeyLayout::getKeyGeometry(int vkCode) const {
+    const KeyRange range = keysFor(vkCode);
+    return range.isEmpty() ? QRect() : m_keys[*range.begin()].geometry;
+}
+
+QString KeyLayout::getKeyLabel(int vkCode) const {
+    const KeyRange range = keysFor(vkCode);
+    return range.isEmpty() ? QString() : m_keys[*range.begin()].label;
 }
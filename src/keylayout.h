@@ -18,9 +18,11 @@
 #define KEYLAYOUT_H
 
 #include <QObject>
-#include <QMap>
 #include <QRect>
 #include <QString>
+#include <QJsonObject>
+#include <vector>
+#include "vkbitmap.h"
 
 struct KeyInfo {
     int vkCode;
@@ -32,21 +34,72 @@ struct KeyInfo {
     double height;
 };
 
+// Keys are kept in layout order in one contiguous array, so a layout may
+// bind several keys to the same vk code (e.g. a split layout repeating a
+// key). A vk -> key index table in compressed form (offsets into one index
+// array) is built at load and answers keysFor() without searching.
 class KeyLayout : public QObject {
     Q_OBJECT
 
 public:
+    // The indices into keys() bound to one vk code, in layout order.
+    class KeyRange {
+    public:
+        KeyRange(const int* first, const int* last)
+            : m_first(first)
+            , m_last(last)
+        {
+        }
+
+        const int* begin() const { return m_first; }
+        const int* end() const { return m_last; }
+        bool isEmpty() const { return m_first == m_last; }
+        int size() const { return static_cast<int>(m_last - m_first); }
+
+    private:
+        const int* m_first;
+        const int* m_last;
+    };
+
     explicit KeyLayout(QObject* parent = nullptr);
 
     bool loadFromFile(const QString& filePath);
-    const QMap<int, KeyInfo>& keys() const { return m_keys; }
+    // Like loadFromFile(), but through LayoutCache: the JSON is parsed only
+    // when the file is new or changed since it was last compiled.
+    bool loadFromCache(const QString& filePath);
+    bool loadFromData(const QByteArray& data, const QString& filePath);
+    bool loadFromJson(const QJsonObject& root);
+
+    // Compact binary form of the loaded layout, including the vk index, so
+    // loadCompiled() restores it without parsing or re-indexing. Native
+    // byte order; returns false for data that is truncated or inconsistent.
+    QByteArray compiled() const;
+    bool loadCompiled(const uchar* data, qint64 size);
+    const std::vector<KeyInfo>& keys() const { return m_keys; }
     const QString& name() const { return m_name; }
 
+    KeyRange keysFor(int vkCode) const {
+        if (!VkBitmap::isValid(vkCode)) return KeyRange(nullptr, nullptr);
+        const int* indices = m_keyIndices.data();
+        return KeyRange(indices + m_vkOffsets[vkCode], indices + m_vkOffsets[vkCode + 1]);
+    }
+    // Every vk code that has at least one key.
+    const VkBitmap& vkCodes() const { return m_vkCodes; }
+    // Union of all key geometries.
+    const QRect& bounds() const { return m_bounds; }
+
+    // First key bound to the vk code.
     QRect getKeyGeometry(int vkCode) const;
     QString getKeyLabel(int vkCode) const;
 
 private:
-    QMap<int, KeyInfo> m_keys;
+    void buildIndex();
+
+    std::vector<KeyInfo> m_keys;
+    int m_vkOffsets[VkBitmap::Size + 1] = {};
+    std::vector<int> m_keyIndices;
+    VkBitmap m_vkCodes;
+    QRect m_bounds;
     QString m_name;
     int m_unitWidth = 40;
     int m_unitHeight = 40;
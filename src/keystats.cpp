@@ -15,70 +15,188 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "keystats.h"
-#include <QDateTime>
 #include <QJsonObject>
+#include <QDateTime>
+#include "latency.h"
+#include "metrics.h"
+#include "eventlog.h"
 
 KeyStats::KeyStats(QObject* parent)
     : QObject(parent)
 {
+    m_clock.start();
+    m_wallBaseMs = QDateTime::currentMSecsSinceEpoch();
+
+    // Armed by presses and stopped once the rates have decayed to zero.
     m_kpsTimer = new QTimer(this);
+    m_kpsTimer->setInterval(100);
     connect(m_kpsTimer, &QTimer::timeout, this, &KeyStats::updateKps);
-    m_kpsTimer->start(100);
+
+    publish();
+}
+
+// Every change bumps the version first. The snapshot is rebuilt once the
+// current batch of events has been handled, so a burst costs one copy.
+void KeyStats::changed() {
+    if (!m_publishPending) {
+        m_publishPending = true;
+        QMetaObject::invokeMethod(this, &KeyStats::publish, Qt::QueuedConnection);
+    }
+    emit statsUpdated();
+}
+
+void KeyStats::publish() {
+    m_publishPending = false;
+
+    auto snapshot = std::make_shared<StatsSnapshot>();
+    snapshot->version = m_version;
+    snapshot->resetGeneration = m_resetGeneration;
+    snapshot->totalKeyPresses = m_totalKeyPresses;
+    snapshot->kps = m_kps;
+    snapshot->kps1s = m_kpsMeter.rate(KpsMeter::Window1s);
+    snapshot->kps5s = m_kpsMeter.rate(KpsMeter::Window5s);
+    snapshot->peakKps = m_kpsMeter.peak();
+    snapshot->pressedKeys = m_pressedKeys;
+    snapshot->keyCounts = m_keyCounts;
+    snapshot->timing.reserve(static_cast<size_t>(m_timing.keys().count()));
+    for (int vk : m_timing.keys()) {
+        snapshot->timing.push_back({ vk, m_timing.hold(vk), m_timing.interval(vk) });
+    }
+    std::atomic_store(&m_snapshot, std::shared_ptr<const StatsSnapshot>(std::move(snapshot)));
+    emit snapshotPublished();
 }
 
-void KeyStats::setValidKeys(const QSet<int>& validKeys) {
+void KeyStats::setValidKeys(const VkBitmap& validKeys) {
     m_validKeys = validKeys;
+    m_filterKeys = !validKeys.isEmpty();
 }
 
 void KeyStats::recordKeyPress(int vkCode) {
-    if (!m_validKeys.isEmpty() && !m_validKeys.contains(vkCode)) {
-        return;
+    if (press(vkCode, m_clock.elapsed())) {
+        Latency::instance()->ingested();
+    }
+}
+
+void KeyStats::recordKeyRelease(int vkCode) {
+    if (release(vkCode, m_clock.elapsed())) {
+        Latency::instance()->ingested();
+    }
+}
+
+void KeyStats::recordKeyPressAt(int vkCode, qint64 timeMs) {
+    press(vkCode, timeMs);
+}
+
+void KeyStats::recordKeyReleaseAt(int vkCode, qint64 timeMs) {
+    release(vkCode, timeMs);
+}
+
+// The meters and timing statistics expect non-decreasing times, so a late
+// event is counted at the latest time already seen.
+bool KeyStats::press(int vkCode, qint64 timeMs) {
+    if (!VkBitmap::isValid(vkCode) || (m_filterKeys && !m_validKeys.contains(vkCode))) {
+        Metrics::instance()->add(Metrics::EventsFiltered);
+        return false;
     }
     
     m_pressedKeys.insert(vkCode);
-    
-    if (m_keyCounts.contains(vkCode)) {
-        m_keyCounts[vkCode]++;
-    } else {
-        m_keyCounts[vkCode] = 1;
-    }
+    m_keyCounts.increment(vkCode);
 
-    m_recentKeyPressTimes.append(QDateTime::currentMSecsSinceEpoch());
+    const qint64 now = qBound(m_lastEventMs, timeMs, m_clock.elapsed());
+    m_lastEventMs = now;
+    m_kpsMeter.record(now);
+    m_history.record(m_wallBaseMs + now, vkCode);
+    m_transitions.recordPress(vkCode, now);
+    m_timing.press(vkCode, now);
+    if (!m_kpsTimer->isActive()) {
+        m_kpsTimer->start();
+    }
     m_totalKeyPresses++;
+    m_version++;
+    if (m_eventLog) {
+        m_eventLog->append(vkCode, 0);
+    }
     
-    emit statsUpdated();
+    changed();
+    return true;
 }
 
-void KeyStats::recordKeyRelease(int vkCode) {
+bool KeyStats::release(int vkCode, qint64 timeMs) {
+    if (!m_pressedKeys.contains(vkCode)) {
+        return false;
+    }
+    const qint64 now = qBound(m_lastEventMs, timeMs, m_clock.elapsed());
+    m_lastEventMs = now;
     m_pressedKeys.remove(vkCode);
+    m_timing.release(vkCode, now);
+    m_version++;
+    if (m_eventLog) {
+        m_eventLog->append(vkCode, EventLog::FlagRelease);
+    }
+    changed();
+    return true;
 }
 
 void KeyStats::updateKps() {
-    qint64 now = QDateTime::currentMSecsSinceEpoch();
-    qint64 windowStart = now - 100;
+    const double rate1s = m_kpsMeter.rate(KpsMeter::Window1s);
+    const double rate5s = m_kpsMeter.rate(KpsMeter::Window5s);
+    const double rate100ms = m_kpsMeter.rate(KpsMeter::Window100ms);
+    const int kps = m_kps;
+
+    Metrics::instance()->add(Metrics::TimerWakeups);
+    qint64 now = m_clock.elapsed();
+    m_kpsMeter.advance(now);
+    m_kps = qRound(m_kpsMeter.smoothed(now));
 
-    while (!m_recentKeyPressTimes.isEmpty() && m_recentKeyPressTimes.first() < windowStart) {
-        m_recentKeyPressTimes.removeFirst();
+    // The 5 s window drains last; after that nothing changes until a press.
+    if (m_kps == 0 && m_kpsMeter.rate(KpsMeter::Window5s) == 0) {
+        m_kpsTimer->stop();
     }
 
-    m_kpsInstant = m_recentKeyPressTimes.size() * 10;
-    
-    const double alpha = 0.5;
-    m_kps = static_cast<int>(alpha * m_kpsInstant + (1 - alpha) * m_kps);
+    // Once the windows have drained, idle ticks change nothing.
+    if (m_kps == kps && m_kpsMeter.rate(KpsMeter::Window1s) == rate1s
+        && m_kpsMeter.rate(KpsMeter::Window5s) == rate5s
+        && m_kpsMeter.rate(KpsMeter::Window100ms) == rate100ms) {
+        return;
+    }
+    m_version++;
     
-    emit statsUpdated();
+    changed();
 }
 
 QVariantMap KeyStats::getStatsJson() const {
     QVariantMap stats;
     stats["totalKeyPresses"] = m_totalKeyPresses;
     stats["kps"] = m_kps;
+    stats["kps100ms"] = m_kpsMeter.rate(KpsMeter::Window100ms);
+    stats["kps1s"] = m_kpsMeter.rate(KpsMeter::Window1s);
+    stats["kps5s"] = m_kpsMeter.rate(KpsMeter::Window5s);
+    stats["peakKps"] = m_kpsMeter.peak();
+    stats["keysDown"] = keysDown();
     
     QVariantMap keyCounts;
     for (auto it = m_keyCounts.constBegin(); it != m_keyCounts.constEnd(); ++it) {
         keyCounts[QString::number(it.key())] = it.value();
     }
     stats["keyCounts"] = keyCounts;
+
+    auto timingMap = [](const TimingStats& series) {
+        QVariantMap map;
+        map["count"] = series.count();
+        map["meanMs"] = series.mean();
+        map["stddevMs"] = series.stddev();
+        map["minMs"] = series.min();
+        map["maxMs"] = series.max();
+        return map;
+    };
+    QVariantMap timing;
+    for (int vk : m_timing.keys()) {
+        QVariantMap key;
+        if (m_timing.hold(vk).count()) key["hold"] = timingMap(m_timing.hold(vk));
+        if (m_timing.interval(vk).count()) key["interval"] = timingMap(m_timing.interval(vk));
+        timing[QString::number(vk)] = key;
+    }
+    stats["timing"] = timing;
     
     return stats;
 }
@@ -86,9 +204,25 @@ QVariantMap KeyStats::getStatsJson() const {
 void KeyStats::reset() {
     m_keyCounts.clear();
     m_pressedKeys.clear();
-    m_recentKeyPressTimes.clear();
+    m_kpsMeter.reset();
+    m_transitions.reset();
+    m_timing.reset();
     m_totalKeyPresses = 0;
     m_kps = 0;
-    m_kpsInstant = 0;
-    emit statsUpdated();
+    m_version++;
+    m_resetGeneration++;
+    if (m_eventLog) {
+        m_eventLog->append(0, EventLog::FlagReset);
+    }
+    changed();
+}
+
+void KeyStats::restore(const int* counts, int totalKeyPresses) {
+    for (int vk = 0; vk < VkBitmap::Size; ++vk) {
+        m_keyCounts.set(vk, counts[vk]);
+    }
+    m_totalKeyPresses = totalKeyPresses;
+    m_version++;
+    m_resetGeneration++;
+    changed();
 }
@@ -18,9 +18,44 @@
 #define KEYSTATS_H
 
 #include <QObject>
-#include <QMap>
-#include <QSet>
 #include <QTimer>
+#include <QElapsedTimer>
+#include "vkbitmap.h"
+#include "kpsmeter.h"
+#include "keycounts.h"
+#include "historystore.h"
+#include "transitionstats.h"
+#include "keytiming.h"
+#include <memory>
+#include <vector>
+
+class EventLog;
+
+// Immutable copy of the values the server reports, published by KeyStats
+// after each batch of changes so other threads never read live state.
+// Timing statistics of one key, copied out of KeyTiming at publish.
+struct KeyTimingSummary {
+    int vkCode;
+    TimingStats hold;
+    TimingStats interval;
+};
+
+struct StatsSnapshot {
+    quint64 version = 0;
+    // Bumped whenever counters are cleared or replaced rather than counted
+    // up, so consumers of deltas know to start over.
+    quint64 resetGeneration = 0;
+    int totalKeyPresses = 0;
+    int kps = 0;
+    double kps1s = 0;
+    double kps5s = 0;
+    int peakKps = 0;
+    VkBitmap pressedKeys;
+    KeyCounts keyCounts;
+    // Only the keys that have samples, in vk order. Copied rather than
+    // shared, so presses never have to detach the live table.
+    std::vector<KeyTimingSummary> timing;
+};
 
 class KeyStats : public QObject {
     Q_OBJECT
@@ -30,31 +65,77 @@ public:
 
     void recordKeyPress(int vkCode);
     void recordKeyRelease(int vkCode);
-    void setValidKeys(const QSet<int>& validKeys);
+    // Events that happened earlier at timeMs on now()'s clock, e.g. merged
+    // from hub nodes. Times are clamped so they never run backwards or ahead,
+    // and the events are not traced as ingested input.
+    void recordKeyPressAt(int vkCode, qint64 timeMs);
+    void recordKeyReleaseAt(int vkCode, qint64 timeMs);
+    // Monotonic milliseconds the statistics are timed with.
+    qint64 now() const { return m_clock.elapsed(); }
+    // Presses of other keys are ignored; an empty set accepts every key.
+    void setValidKeys(const VkBitmap& validKeys);
+    // Accepted events are appended to the log when one is set.
+    void setEventLog(EventLog* log) { m_eventLog = log; }
+    void restore(const int* counts, int totalKeyPresses);
 
     int totalKeyPresses() const { return m_totalKeyPresses; }
     int kps() const { return m_kps; }
-    const QMap<int, int>& keyCounts() const { return m_keyCounts; }
-    const QSet<int>& pressedKeys() const { return m_pressedKeys; }
+    int peakKps() const { return m_kpsMeter.peak(); }
+    double kpsOver(KpsMeter::Window window) const { return m_kpsMeter.rate(window); }
+    int keysDown() const { return m_pressedKeys.count(); }
+    const KeyCounts& keyCounts() const { return m_keyCounts; }
+    const VkBitmap& pressedKeys() const { return m_pressedKeys; }
+    // Presses by wall-clock time; survives reset().
+    const HistoryStore& history() const { return m_history; }
+    HistoryStore& history() { return m_history; }
+    // Bigram and chord counts since the last reset.
+    const TransitionStats& transitions() const { return m_transitions; }
+    void setChordWindow(int ms) { m_transitions.setChordWindow(ms); }
+    // Per-key hold and same-key interval statistics since the last reset.
+    const KeyTiming& timing() const { return m_timing; }
+
+    // Increases whenever any value reported by the accessors changes.
+    quint64 version() const { return m_version; }
+
+    // Latest published snapshot; callable from any thread, never null.
+    std::shared_ptr<const StatsSnapshot> snapshot() const { return std::atomic_load(&m_snapshot); }
 
     QVariantMap getStatsJson() const;
     void reset();
 
 signals:
     void statsUpdated();
+    // Emitted once per published snapshot, at most once per event-loop pass.
+    void snapshotPublished();
 
 private slots:
     void updateKps();
+    void publish();
 
 private:
-    QMap<int, int> m_keyCounts;
-    QSet<int> m_pressedKeys;
-    QSet<int> m_validKeys;
-    QList<qint64> m_recentKeyPressTimes;
+    void changed();
+    bool press(int vkCode, qint64 timeMs);
+    bool release(int vkCode, qint64 timeMs);
+
+    KeyCounts m_keyCounts;
+    VkBitmap m_pressedKeys;
+    VkBitmap m_validKeys;
+    bool m_filterKeys = false;
+    KpsMeter m_kpsMeter;
+    QElapsedTimer m_clock;
+    qint64 m_wallBaseMs = 0;
+    qint64 m_lastEventMs = 0;
+    HistoryStore m_history;
+    TransitionStats m_transitions;
+    KeyTiming m_timing;
     int m_totalKeyPresses = 0;
     int m_kps = 0;
-    int m_kpsInstant = 0;
+    quint64 m_version = 0;
+    quint64 m_resetGeneration = 0;
     QTimer* m_kpsTimer = nullptr;
+    EventLog* m_eventLog = nullptr;
+    bool m_publishPending = false;
+    std::shared_ptr<const StatsSnapshot> m_snapshot;
 };
 
 #endif
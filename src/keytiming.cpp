@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "keytiming.h"
+#include <cmath>
+
+double TimingStats::stddev() const {
+    return std::sqrt(variance());
+}
+
+KeyTiming::KeyTiming() {
+    m_keys.resize(VkBitmap::Size);
+}
+
+void KeyTiming::press(int vkCode, qint64 timeMs) {
+    KeyState& key = m_keys[vkCode];
+    if (key.downMs >= 0) return;
+    key.downMs = timeMs;
+
+    if (key.lastPressMs >= 0 && timeMs - key.lastPressMs <= MaxIntervalMs) {
+        key.interval.record(static_cast<quint32>(timeMs - key.lastPressMs));
+        m_sampled.insert(vkCode);
+    }
+    key.lastPressMs = timeMs;
+}
+
+void KeyTiming::release(int vkCode, qint64 timeMs) {
+    KeyState& key = m_keys[vkCode];
+    if (key.downMs < 0) return;
+    key.hold.record(static_cast<quint32>(qMin<qint64>(timeMs - key.downMs, 0xFFFFFFFF)));
+    key.downMs = -1;
+    m_sampled.insert(vkCode);
+}
+
+void KeyTiming::reset() {
+    m_keys.fill(KeyState(), VkBitmap::Size);
+    m_sampled.clear();
+}
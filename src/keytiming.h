@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef KEYTIMING_H
+#define KEYTIMING_H
+
+#include <QtGlobal>
+#include <QVector>
+#include "vkbitmap.h"
+#include "loghistogram.h"
+
+// Running statistics of a series of millisecond durations: count, mean and
+// variance (Welford), min/max and a LogHistogram. O(1) per sample, no
+// allocation.
+class TimingStats {
+public:
+    void record(quint32 ms) {
+        ++m_count;
+        const double delta = ms - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (ms - m_mean);
+        m_min = m_count == 1 ? ms : qMin(m_min, ms);
+        m_max = qMax(m_max, ms);
+        m_histogram.record(ms);
+    }
+
+    quint64 count() const { return m_count; }
+    double mean() const { return m_mean; }
+    // Sample variance; 0 until there are two samples.
+    double variance() const { return m_count > 1 ? m_m2 / (m_count - 1) : 0.0; }
+    double stddev() const;
+    quint32 min() const { return m_min; }
+    quint32 max() const { return m_max; }
+    const LogHistogram& histogram() const { return m_histogram; }
+
+private:
+    quint64 m_count = 0;
+    double m_mean = 0;
+    double m_m2 = 0;
+    quint32 m_min = 0;
+    quint32 m_max = 0;
+    LogHistogram m_histogram;
+};
+
+// Per-key hold durations (press to release) and intervals between
+// successive presses of the same key. Auto-repeat presses of a key that is
+// already held are ignored, and intervals longer than MaxIntervalMs are
+// treated as pauses rather than samples. Times are monotonic ms.
+class KeyTiming {
+public:
+    static constexpr int MaxIntervalMs = 2000;
+
+    KeyTiming();
+
+    // vkCode must already be range-checked.
+    void press(int vkCode, qint64 timeMs);
+    void release(int vkCode, qint64 timeMs);
+    void reset();
+
+    const TimingStats& hold(int vkCode) const { return m_keys[vkCode].hold; }
+    const TimingStats& interval(int vkCode) const { return m_keys[vkCode].interval; }
+    // Keys with at least one hold or interval sample.
+    const VkBitmap& keys() const { return m_sampled; }
+
+private:
+    struct KeyState {
+        qint64 downMs = -1;         // -1 while released
+        qint64 lastPressMs = -1;
+        TimingStats hold;
+        TimingStats interval;
+    };
+
+    QVector<KeyState> m_keys;
+    VkBitmap m_sampled;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "kpsmeter.h"
+#include <cmath>
+
+KpsMeter::KpsMeter() {
+    reset();
+}
+
+int KpsMeter::windowBuckets(Window window) {
+    switch (window) {
+    case Window100ms: return 100 / BucketMs;
+    case Window1s: return 1000 / BucketMs;
+    case Window5s: return 5000 / BucketMs;
+    default: return 1;
+    }
+}
+
+void KpsMeter::reset() {
+    for (quint32& bucket : m_buckets) {
+        bucket = 0;
+    }
+    for (quint32& sum : m_windowSums) {
+        sum = 0;
+    }
+    m_currentBucket = 0;
+    m_started = false;
+    m_peak = 0;
+    m_ema = 0;
+    m_emaTimeMs = 0;
+}
+
+void KpsMeter::advance(qint64 nowMs) {
+    const qint64 bucket = nowMs / BucketMs;
+    if (!m_started) {
+        m_currentBucket = bucket;
+        m_started = true;
+        return;
+    }
+    if (bucket <= m_currentBucket) {
+        return;
+    }
+
+    if (bucket - m_currentBucket >= BucketCount) {
+        // Idle for longer than the ring: every window is empty.
+        for (quint32& b : m_buckets) {
+            b = 0;
+        }
+        for (quint32& sum : m_windowSums) {
+            sum = 0;
+        }
+        m_currentBucket = bucket;
+        return;
+    }
+
+    while (m_currentBucket < bucket) {
+        ++m_currentBucket;
+        for (int w = 0; w < WindowCount; ++w) {
+            const qint64 leaving = m_currentBucket - windowBuckets(static_cast<Window>(w));
+            m_windowSums[w] -= m_buckets[leaving & (BucketCount - 1)];
+        }
+        // The ring is longer than the widest window, so the slot being
+        // reused has already left every window.
+        m_buckets[m_currentBucket & (BucketCount - 1)] = 0;
+    }
+}
+
+void KpsMeter::record(qint64 nowMs) {
+    advance(nowMs);
+
+    ++m_buckets[m_currentBucket & (BucketCount - 1)];
+    for (quint32& sum : m_windowSums) {
+        ++sum;
+    }
+    if (static_cast<int>(m_windowSums[Window1s]) > m_peak) {
+        m_peak = static_cast<int>(m_windowSums[Window1s]);
+    }
+
+    m_ema = smoothed(nowMs) + 1000.0 / m_tauMs;
+    m_emaTimeMs = nowMs;
+}
+
+double KpsMeter::rate(Window window) const {
+    return m_windowSums[window] * 1000.0 / (windowBuckets(window) * BucketMs);
+}
+
+double KpsMeter::smoothed(qint64 nowMs) const {
+    if (m_ema == 0 || nowMs <= m_emaTimeMs) {
+        return m_ema;
+    }
+    return m_ema * std::exp(-static_cast<double>(nowMs - m_emaTimeMs) / m_tauMs);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef KPSMETER_H
+#define KPSMETER_H
+
+#include <QtGlobal>
+
+// Key-press rate over sliding windows, backed by a ring of 10 ms buckets.
+// Each window keeps a running sum that is adjusted as buckets enter and
+// leave it, so recording and reading are O(1) (advancing is bounded by the
+// ring size after long idle gaps). Times are monotonic milliseconds.
+class KpsMeter {
+public:
+    enum Window {
+        Window100ms,
+        Window1s,
+        Window5s,
+        WindowCount
+    };
+
+    static constexpr int BucketMs = 10;
+    static constexpr int BucketCount = 512;
+
+    KpsMeter();
+
+    void record(qint64 nowMs);
+    void advance(qint64 nowMs);
+    void reset();
+
+    // Presses per second over the window, as of the last record/advance.
+    double rate(Window window) const;
+    // Highest presses-per-second seen over any 1 s window since reset.
+    int peak() const { return m_peak; }
+
+    // Exponentially time-decayed rate: every press contributes 1/tau and
+    // decays with exp(-dt/tau), so the value is correct at any read time
+    // without periodic sampling.
+    double smoothed(qint64 nowMs) const;
+    void setSmoothingMs(int tauMs) { m_tauMs = tauMs > 0 ? tauMs : 1; }
+
+private:
+    static int windowBuckets(Window window);
+
+    quint32 m_buckets[BucketCount];
+    quint32 m_windowSums[WindowCount];
+    qint64 m_currentBucket = 0;
+    bool m_started = false;
+    int m_peak = 0;
+
+    double m_ema = 0;
+    qint64 m_emaTimeMs = 0;
+    int m_tauMs = 500;
+};
+
+#endif
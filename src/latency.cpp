@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "latency.h"
+#include <QtAlgorithms>
+#include <chrono>
+
+int LatencyHistogram::bucketIndex(quint64 us) {
+    if (us < SubBucketCount) {
+        return static_cast<int>(us);
+    }
+    if (us > 0xFFFFFFFFu) {
+        us = 0xFFFFFFFFu;
+    }
+    const int msb = 63 - qCountLeadingZeroBits(us);
+    const int shift = msb - SubBucketBits;
+    const int sub = static_cast<int>(us >> shift) - SubBucketCount;
+    return (shift + 1) * SubBucketCount + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SubBucketCount) {
+        return static_cast<quint64>(index);
+    }
+    const int shift = index / SubBucketCount - 1;
+    const quint64 sub = static_cast<quint64>(index % SubBucketCount + SubBucketCount);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(quint64 us) {
+    m_buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(us, std::memory_order_relaxed);
+
+    quint64 max = m_max.load(std::memory_order_relaxed);
+    while (us > max && !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+// Buckets are read one by one while recording may continue, so the result
+// is approximate under concurrent writes, which is fine for monitoring.
+quint64 LatencyHistogram::percentile(double quantile) const {
+    quint64 counts[BucketCount];
+    quint64 total = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const quint64 rank = qMax<quint64>(1, static_cast<quint64>(quantile * total + 0.999999));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return qMin(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
+
+Latency* Latency::instance() {
+    static Latency latency;
+    return &latency;
+}
+
+quint32 Latency::stamp() {
+    using namespace std::chrono;
+    return static_cast<quint32>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+const char* Latency::stageName(Stage stage) {
+    switch (stage) {
+    case HookDelivery: return "hook_delivery";
+    case Ingest: return "ingest";
+    case Serialize: return "serialize";
+    case Write: return "write";
+    case Echo: return "echo";
+    default: return "unknown";
+    }
+}
+
+void Latency::ingested() {
+    // Each stamp is ingested once.
+    if (!m_hasCurrentStamp) {
+        return;
+    }
+    m_hasCurrentStamp = false;
+    record(Ingest, m_currentStamp);
+
+    // Keep the oldest stamp until the server takes it; bit 32 marks the
+    // slot as occupied so a zero stamp is still valid.
+    quint64 expected = 0;
+    m_pendingStamp.compare_exchange_strong(expected, (Q_UINT64_C(1) << 32) | m_currentStamp,
+                                           std::memory_order_relaxed);
+}
+
+bool Latency::takeIngested(quint32& stamp) {
+    const quint64 pending = m_pendingStamp.exchange(0, std::memory_order_relaxed);
+    if (pending == 0) {
+        return false;
+    }
+    stamp = static_cast<quint32>(pending);
+    return true;
+}
+
+void Latency::writeMetrics(QByteArray& out) const {
+    static const struct { const char* label; double quantile; } quantiles[] = {
+        { "0.5", 0.5 }, { "0.99", 0.99 }, { "0.999", 0.999 }
+    };
+
+    out += "# HELP keystatics_latency_microseconds Time from hook entry to each pipeline stage.\n";
+    out += "# TYPE keystatics_latency_microseconds summary\n";
+    for (int s = 0; s < StageCount; ++s) {
+        const LatencyHistogram& histogram = m_histograms[s];
+        const QByteArray stage = stageName(static_cast<Stage>(s));
+        for (const auto& q : quantiles) {
+            out += "keystatics_latency_microseconds{stage=\"" + stage + "\",quantile=\"" + q.label + "\"} "
+                + QByteArray::number(histogram.percentile(q.quantile)) + "\n";
+        }
+        out += "keystatics_latency_microseconds_sum{stage=\"" + stage + "\"} "
+            + QByteArray::number(histogram.sum()) + "\n";
+        out += "keystatics_latency_microseconds_count{stage=\"" + stage + "\"} "
+            + QByteArray::number(histogram.count()) + "\n";
+    }
+    out += "# HELP keystatics_latency_max_microseconds Largest latency seen per stage.\n";
+    out += "# TYPE keystatics_latency_max_microseconds gauge\n";
+    for (int s = 0; s < StageCount; ++s) {
+        out += "keystatics_latency_max_microseconds{stage=\"" + QByteArray(stageName(static_cast<Stage>(s)))
+            + "\"} " + QByteArray::number(m_histograms[s].max()) + "\n";
+    }
+}
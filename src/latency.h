@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <atomic>
+
+// Log-linear latency histogram in microseconds, HDR style: each power of
+// two is split into 32 linear sub-buckets, so any recorded value is
+// reported within ~3% across the whole range. Recording is a few relaxed
+// atomic increments and may happen from any thread.
+class LatencyHistogram {
+public:
+    static constexpr int SubBucketBits = 5;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    static constexpr int BucketCount = (32 - SubBucketBits + 1) * SubBucketCount;
+
+    void record(quint64 us);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    quint64 sum() const { return m_sum.load(std::memory_order_relaxed); }
+    quint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    // Upper bound of the bucket holding the given quantile (0..1).
+    quint64 percentile(double quantile) const;
+
+    static int bucketIndex(quint64 us);
+    static quint64 bucketUpperBound(int index);
+
+private:
+    std::atomic<quint64> m_buckets[BucketCount] = {};
+    std::atomic<quint64> m_count{0};
+    std::atomic<quint64> m_sum{0};
+    std::atomic<quint64> m_max{0};
+};
+
+// End-to-end input latency tracing. Every InputEvent carries a stamp()
+// taken at hook entry; each pipeline stage records the time elapsed
+// since that stamp into its own histogram.
+class Latency {
+public:
+    enum Stage {
+        HookDelivery,   // OS event time to hook entry, posted events only (ms resolution)
+        Ingest,         // hook entry to KeyStats
+        Serialize,      // hook entry to push frame serialized
+        Write,          // hook entry to frame written to all sockets
+        Echo,           // hook entry to the overlay page reporting the frame shown
+        StageCount
+    };
+
+    static Latency* instance();
+
+    // Monotonic microsecond clock, truncated to 32 bits; differences are
+    // taken modulo 2^32, which is fine for anything under an hour.
+    static quint32 stamp();
+    static quint32 elapsedSince(quint32 start) { return stamp() - start; }
+    static const char* stageName(Stage stage);
+
+    void record(Stage stage, quint32 start) { m_histograms[stage].record(elapsedSince(start)); }
+    void recordUs(Stage stage, quint64 us) { m_histograms[stage].record(us); }
+    const LatencyHistogram& histogram(Stage stage) const { return m_histograms[stage]; }
+
+    // The dispatcher sets the stamp of the event it is delivering and
+    // clears it once delivered; the stats ingest it (recording Ingest) and
+    // the oldest ingested stamp not yet broadcast is handed to the server
+    // with takeIngested(). Events that did not come through the dispatcher
+    // (hub nodes, benchmarks) have no stamp and are not traced.
+    void setCurrentEvent(quint32 stamp) {
+        m_currentStamp = stamp;
+        m_hasCurrentStamp = true;
+    }
+    void clearCurrentEvent() { m_hasCurrentStamp = false; }
+    void ingested();
+    bool takeIngested(quint32& stamp);
+
+    void writeMetrics(QByteArray& out) const;
+
+private:
+    Latency() = default;
+
+    LatencyHistogram m_histograms[StageCount];
+    quint32 m_currentStamp = 0;
+    bool m_hasCurrentStamp = false;
+    std::atomic<quint64> m_pendingStamp{0};
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "layoutcache.h"
+#include "keylayout.h"
+#include "metrics.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+const char CacheMagic[8] = { 'K', 'S', 'L', 'A', 'Y', 'O', 'U', 'T' };
+// Bump when the file layout or KeyLayout::compiled() changes.
+const quint32 CacheVersion = 1;
+
+struct CacheHeader {
+    char magic[8];
+    quint32 version;
+    quint32 entryCount;
+};
+
+// Followed by the source path (UTF-8) and the compiled layout, each padded
+// to 8 bytes.
+struct EntryHeader {
+    quint32 pathBytes;
+    quint32 dataBytes;
+    qint64 sourceMtimeMs;
+    qint64 sourceSize;
+    quint64 sourceHash;
+};
+
+static_assert(sizeof(CacheHeader) == 16, "layout cache header size");
+static_assert(sizeof(EntryHeader) == 32, "layout cache entry header size");
+
+qint64 padded(qint64 size) {
+    return (size + 7) & ~qint64(7);
+}
+
+void appendPadded(QByteArray& out, const char* data, qint64 size) {
+    out.append(data, static_cast<int>(size));
+    out.append(static_cast<int>(padded(size) - size), '\0');
+}
+
+// FNV-1a: stable across runs and builds, unlike qHash.
+quint64 contentHash(const QByteArray& data) {
+    quint64 hash = 14695981039346656037ULL;
+    for (char c : data) {
+        hash = (hash ^ static_cast<uchar>(c)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+}
+
+LayoutCache* LayoutCache::instance() {
+    static LayoutCache cache;
+    return &cache;
+}
+
+LayoutCache::LayoutCache()
+    : m_fileName(QCoreApplication::applicationDirPath() + "/cache/layouts.bin")
+{
+}
+
+bool LayoutCache::load(const QString& filePath, KeyLayout* layout) {
+    if (!m_opened) {
+        open();
+    }
+
+    const QFileInfo info(filePath);
+    const QString key = info.absoluteFilePath();
+    const qint64 mtimeMs = info.lastModified().toMSecsSinceEpoch();
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->sourceSize == info.size() && it->sourceMtimeMs == mtimeMs
+        && layout->loadCompiled(reinterpret_cast<const uchar*>(it->data.constData()), it->data.size())) {
+        Metrics::instance()->add(Metrics::LayoutCacheHits);
+        return true;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open layout file:" << filePath;
+        return false;
+    }
+    const QByteArray source = file.readAll();
+    file.close();
+    const quint64 hash = contentHash(source);
+
+    // Touched or copied but unchanged: only the modification time is new.
+    if (it != m_entries.end() && it->sourceSize == source.size() && it->sourceHash == hash
+        && layout->loadCompiled(reinterpret_cast<const uchar*>(it->data.constData()), it->data.size())) {
+        Metrics::instance()->add(Metrics::LayoutCacheHits);
+        it->sourceMtimeMs = mtimeMs;
+        save();
+        return true;
+    }
+
+    Metrics::instance()->add(Metrics::LayoutCacheMisses);
+    if (!layout->loadFromData(source, filePath)) {
+        return false;
+    }
+    Entry entry;
+    entry.sourceMtimeMs = mtimeMs;
+    entry.sourceSize = source.size();
+    entry.sourceHash = hash;
+    entry.data = layout->compiled();
+    m_entries.insert(key, entry);
+    save();
+    return true;
+}
+
+void LayoutCache::open() {
+    m_opened = true;
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const qint64 size = m_file.size();
+    if (size >= static_cast<qint64>(sizeof(CacheHeader))) {
+        m_map = m_file.map(0, size);
+    }
+    if (!m_map) {
+        m_file.close();
+        return;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, m_map, sizeof(header));
+    if (std::memcmp(header.magic, CacheMagic, sizeof(header.magic)) != 0 || header.version != CacheVersion) {
+        qDebug() << "Ignoring layout cache of another version:" << m_fileName;
+        unmap();
+        return;
+    }
+
+    qint64 pos = sizeof(header);
+    for (quint32 i = 0; i < header.entryCount; ++i) {
+        EntryHeader entryHeader;
+        if (pos + static_cast<qint64>(sizeof(entryHeader)) > size) break;
+        std::memcpy(&entryHeader, m_map + pos, sizeof(entryHeader));
+        const qint64 pathPos = pos + static_cast<qint64>(sizeof(entryHeader));
+        const qint64 dataPos = pathPos + padded(entryHeader.pathBytes);
+        const qint64 next = dataPos + padded(entryHeader.dataBytes);
+        if (next > size) break;
+
+        Entry entry;
+        entry.sourceMtimeMs = entryHeader.sourceMtimeMs;
+        entry.sourceSize = entryHeader.sourceSize;
+        entry.sourceHash = entryHeader.sourceHash;
+        entry.data = QByteArray::fromRawData(reinterpret_cast<const char*>(m_map + dataPos),
+                                             static_cast<int>(entryHeader.dataBytes));
+        m_entries.insert(QString::fromUtf8(reinterpret_cast<const char*>(m_map + pathPos),
+                                           static_cast<int>(entryHeader.pathBytes)), entry);
+        pos = next;
+    }
+    qDebug() << "Layout cache:" << m_entries.size() << "compiled layouts in" << m_fileName;
+}
+
+void LayoutCache::unmap() {
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+}
+
+// Writes every entry whose source still exists to a new file, then maps
+// that file in place of the old one.
+bool LayoutCache::save() {
+    QByteArray out;
+    CacheHeader header = {};
+    std::memcpy(header.magic, CacheMagic, sizeof(header.magic));
+    header.version = CacheVersion;
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        if (!QFileInfo::exists(it.key())) continue;
+        const QByteArray path = it.key().toUtf8();
+        EntryHeader entryHeader = {};
+        entryHeader.pathBytes = static_cast<quint32>(path.size());
+        entryHeader.dataBytes = static_cast<quint32>(it->data.size());
+        entryHeader.sourceMtimeMs = it->sourceMtimeMs;
+        entryHeader.sourceSize = it->sourceSize;
+        entryHeader.sourceHash = it->sourceHash;
+        out.append(reinterpret_cast<const char*>(&entryHeader), sizeof(entryHeader));
+        appendPadded(out, path.constData(), path.size());
+        appendPadded(out, it->data.constData(), it->data.size());
+        ++header.entryCount;
+    }
+    std::memcpy(out.data() + offsetof(CacheHeader, entryCount), &header.entryCount, sizeof(header.entryCount));
+
+    // The mapped file is about to be replaced (which Windows refuses while
+    // it is mapped), so entries still pointing into it get their own copy.
+    for (Entry& entry : m_entries) {
+        entry.data = QByteArray(entry.data.constData(), entry.data.size());
+    }
+    unmap();
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit()) {
+        qWarning() << "Cannot write layout cache:" << m_fileName << file.errorString();
+        return false;
+    }
+
+    m_entries.clear();
+    open();
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef LAYOUTCACHE_H
+#define LAYOUTCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+class KeyLayout;
+
+// Compiled layouts (KeyLayout::compiled()) of every layout file loaded so
+// far, kept in one memory-mapped file, cache/layouts.bin next to the
+// executable. An entry is used while its source keeps the same size and
+// modification time, or the same content after it was only touched or
+// copied, so startup and layout switches restore a compact record instead
+// of parsing JSON. The file is rewritten whenever an entry is added or
+// refreshed; a file with another version is ignored and replaced.
+// Not thread-safe; layouts are loaded on the GUI thread.
+class LayoutCache {
+public:
+    static LayoutCache* instance();
+
+    // Loads filePath into layout, from the cache when its entry is current
+    // and from the JSON otherwise, adding the result to the cache. A file
+    // that cannot be read or parsed leaves the cache as it is.
+    bool load(const QString& filePath, KeyLayout* layout);
+
+private:
+    // An entry read from the file refers into the mapping.
+    struct Entry {
+        qint64 sourceMtimeMs = 0;
+        qint64 sourceSize = 0;
+        quint64 sourceHash = 0;
+        QByteArray data;
+    };
+
+    LayoutCache();
+    void open();
+    void unmap();
+    bool save();
+
+    QString m_fileName;
+    QFile m_file;
+    uchar* m_map = nullptr;
+    bool m_opened = false;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef LOGHISTOGRAM_H
+#define LOGHISTOGRAM_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+// Millisecond durations counted in power-of-two buckets: bucket 0 holds
+// 0 ms, bucket i holds [2^(i-1), 2^i) ms and the last bucket everything
+// from 2^(BucketCount-2) ms up. Fixed 64 bytes, so many of them can live in
+// preallocated tables.
+class LogHistogram {
+public:
+    static constexpr int BucketCount = 16;
+
+    static int bucketFor(quint32 ms) {
+        const int bucket = ms ? 32 - static_cast<int>(qCountLeadingZeroBits(ms)) : 0;
+        return bucket < BucketCount ? bucket : BucketCount - 1;
+    }
+
+    // Exclusive upper edge of a bucket in ms; the last bucket is open.
+    static quint32 upperBound(int bucket) { return 1u << bucket; }
+
+    void record(quint32 ms) { ++m_buckets[bucketFor(ms)]; }
+
+    quint32 bucket(int index) const { return m_buckets[index]; }
+
+    quint64 count() const {
+        quint64 total = 0;
+        for (quint32 value : m_buckets) {
+            total += value;
+        }
+        return total;
+    }
+
+    // Upper edge of the bucket holding the given quantile (0-1), 0 if empty.
+    quint32 percentile(double quantile) const {
+        const quint64 total = count();
+        if (!total) return 0;
+        const quint64 rank = qMax<quint64>(1, static_cast<quint64>(quantile * total + 0.5));
+        quint64 seen = 0;
+        for (int i = 0; i < BucketCount; ++i) {
+            seen += m_buckets[i];
+            if (seen >= rank) return upperBound(i);
+        }
+        return upperBound(BucketCount - 1);
+    }
+
+    void clear() {
+        for (quint32& value : m_buckets) {
+            value = 0;
+        }
+    }
+
+private:
+    quint32 m_buckets[BucketCount] = {};
+};
+
+#endif
@@ -81,6 +81,19 @@ bool checkPortAndNotify(quint16 port) {
     return false;
 }
 
+// Hub nodes may share a machine with each other or with the hub; each one
+// takes the next free port instead of refusing to start.
+quint16 findFreePort(quint16 port) {
+    for (int candidate = port; candidate < port + 32 && candidate <= 0xFFFF; ++candidate) {
+        QTcpServer testServer;
+        if (testServer.listen(QHostAddress::Any, static_cast<quint16>(candidate))) {
+            testServer.close();
+            return static_cast<quint16>(candidate);
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
     app.setApplicationName("key-statics");
@@ -89,6 +102,15 @@ int main(int argc, char *argv[]) {
     Config::instance()->load();
     quint16 port = Config::instance()->serverPort();
     
+    const bool hubNode = !Config::instance()->hubConnect().isEmpty();
+    if (hubNode && Config::instance()->autoPortIfOccupied()) {
+        quint16 freePort = findFreePort(port);
+        if (freePort != port && freePort != 0) {
+            qDebug() << "Port" << port << "is occupied, hub node serving on" << freePort;
+            Config::instance()->setServerPort(freePort);
+            port = freePort;
+        }
+    }
     if (!checkPortAndNotify(port)) {
         return 1;
     }
@@ -20,6 +20,7 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <QFileInfo>
+#include <QScreen>
 
 #include "config.h"
 
@@ -37,7 +38,28 @@ MainWindow::MainWindow(QWidget* parent)
     m_keyboard->setLayout(m_layout);
     setCentralWidget(m_keyboard);
 
+    m_renderScheduler = new RenderScheduler(this);
+    int targetFps = Config::instance()->targetFps();
+    if (targetFps > 0) {
+        m_renderScheduler->setTargetFps(targetFps);
+    } else if (QScreen* screen = QGuiApplication::primaryScreen()) {
+        m_renderScheduler->setTargetFps(screen->refreshRate());
+    }
+    m_keyboard->setRenderScheduler(m_renderScheduler);
+
     m_keyStats = new KeyStats(this);
+    m_keyStats->setChordWindow(Config::instance()->chordWindowMs());
+
+    if (Config::instance()->storageEnabled()) {
+        m_eventLog = new EventLog(this);
+        m_eventLog->setSyncInterval(Config::instance()->storageSyncIntervalMs());
+        EventLog::RestoredCounts restored;
+        if (m_eventLog->open(Config::instance()->storageDirectory(), &restored, &m_keyStats->history())) {
+            m_keyStats->restore(restored.counts, restored.totalKeyPresses);
+            m_eventLog->setStats(m_keyStats);
+            m_keyStats->setEventLog(m_eventLog);
+        }
+    }
 
     QString defaultLayout = Config::instance()->defaultLayout();
     QString layoutPath = QApplication::applicationDirPath() + "/layouts/" + defaultLayout + ".json";
@@ -50,30 +72,50 @@ MainWindow::MainWindow(QWidget* parent)
         qWarning() << "Failed to load keyboard layout!";
     }
 
-    m_keyboardHook = new KeyboardHook(this);
-    connect(m_keyboardHook, &KeyboardHook::keyPressed, this, &MainWindow::onKeyPressed);
-    connect(m_keyboardHook, &KeyboardHook::keyReleased, this, &MainWindow::onKeyReleased);
+    m_dispatcher = new InputDispatcher(this);
+    connect(m_dispatcher, &InputDispatcher::keyPressed, this, &MainWindow::onKeyPressed);
+    connect(m_dispatcher, &InputDispatcher::keyReleased, this, &MainWindow::onKeyReleased);
+    connect(m_dispatcher, &InputDispatcher::buttonPressed, this, &MainWindow::onMousePressed);
+    connect(m_dispatcher, &InputDispatcher::buttonReleased, this, &MainWindow::onMouseReleased);
 
-    if (!m_keyboardHook->start()) {
-        qWarning() << "Failed to start keyboard hook!";
-    }
-    
-    m_mouseHook = new MouseHook(this);
-    connect(m_mouseHook, &MouseHook::buttonPressed, this, &MainWindow::onMousePressed);
-    connect(m_mouseHook, &MouseHook::buttonReleased, this, &MainWindow::onMouseReleased);
-    
-    if (!m_mouseHook->start()) {
-        qWarning() << "Failed to start mouse hook!";
-    }
+    m_hookThread = new HookThread(m_dispatcher, this);
+    m_hookThread->start();
 
-    m_httpServer = new HttpServer(m_keyStats, this);
+    m_httpServer = new HttpServer(m_keyStats);
     m_httpServer->setLayout(m_layout);
+    m_httpServer->setRenderScheduler(m_renderScheduler);
+
+    // Hub mode: merge other instances into these stats, and/or forward
+    // local input to another instance.
+    if (quint16 hubPort = Config::instance()->hubListenPort()) {
+        m_hubServer = new HubServer(m_keyStats, this);
+        if (m_hubServer->listen(hubPort, QHostAddress(Config::instance()->hubListenAddress()))) {
+            m_httpServer->setHub(m_hubServer);
+        }
+    }
+    if (!Config::instance()->hubConnect().isEmpty()) {
+        m_hubClient = new HubClient(this);
+        m_hubClient->setName(Config::instance()->hubName());
+        if (m_hubClient->connectToHub(Config::instance()->hubConnect())) {
+            HubClient* hub = m_hubClient;
+            connect(m_dispatcher, &InputDispatcher::keyPressed, hub, [hub](int vk) {
+                hub->record(vk, InputEvent::Press, InputEvent::Keyboard);
+            });
+            connect(m_dispatcher, &InputDispatcher::keyReleased, hub, [hub](int vk) {
+                hub->record(vk, InputEvent::Release, InputEvent::Keyboard);
+            });
+            connect(m_dispatcher, &InputDispatcher::buttonPressed, hub, [hub](int vk) {
+                hub->record(vk, InputEvent::Press, InputEvent::Mouse);
+            });
+            connect(m_dispatcher, &InputDispatcher::buttonReleased, hub, [hub](int vk) {
+                hub->record(vk, InputEvent::Release, InputEvent::Mouse);
+            });
+        }
+    }
     
     quint16 port = Config::instance()->serverPort();
     if (!m_httpServer->start(port)) {
         qWarning() << "Failed to start HTTP server!";
-    } else {
-        qDebug() << "HTTP server started on port" << port;
     }
 
     m_sysTray = new SysTray(this, this);
@@ -98,41 +140,54 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_sysTray, &SysTray::layoutChanged, this, &MainWindow::updateLayoutDisplayName);
     
     updateLayoutDisplayName(layoutPath);
+
+    // Edits to config.json or the current layout are applied while running.
+    m_configWatcher = new ConfigWatcher(QApplication::applicationDirPath() + "/config.json",
+                                        QApplication::applicationDirPath() + "/layouts", this);
+    connect(m_configWatcher, &ConfigWatcher::configChanged, this, &MainWindow::reloadConfig);
+    connect(m_configWatcher, &ConfigWatcher::layoutChanged, this, &MainWindow::reloadLayout);
+    connect(m_configWatcher, &ConfigWatcher::layoutListChanged, m_sysTray, &SysTray::setLayoutFiles);
 }
 
 MainWindow::~MainWindow() {
-    if (m_keyboardHook) {
-        m_keyboardHook->stop();
+    if (m_hookThread) {
+        m_hookThread->stop();
     }
-    if (m_mouseHook) {
-        m_mouseHook->stop();
+    // The server runs on its own thread and cannot be parented.
+    delete m_httpServer;
+    if (m_hubClient) {
+        m_hubClient->disconnectFromHub();
     }
-    if (m_httpServer) {
-        m_httpServer->stop();
+    if (m_eventLog) {
+        m_eventLog->close();
     }
 }
 
 bool MainWindow::loadLayout(const QString& layoutFile) {
-    if (m_layout->loadFromFile(layoutFile)) {
-        if (m_keyboard) {
-            m_keyboard->setLayout(m_layout);
-            adjustSize();
-        }
-        if (m_keyStats) {
-            QSet<int> validKeys;
-            for (int vk : m_layout->keys().keys()) {
-                validKeys.insert(vk);
-            }
-            m_keyStats->setValidKeys(validKeys);
-        }
-        
-        if (m_httpServer) {
-            m_httpServer->setLayout(m_layout);
-        }
-        
-        return true;
+    // Parse into a fresh layout so a broken file leaves the current one in
+    // place; everything is switched over only once parsing succeeded.
+    KeyLayout* layout = new KeyLayout(this);
+    if (!layout->loadFromCache(layoutFile)) {
+        delete layout;
+        return false;
     }
-    return false;
+
+    KeyLayout* previous = m_layout;
+    m_layout = layout;
+    if (m_keyboard) {
+        m_keyboard->setLayout(m_layout);
+        adjustSize();
+    }
+    if (m_keyStats) {
+        m_keyStats->setValidKeys(m_layout->vkCodes());
+    }
+    
+    if (m_httpServer) {
+        m_httpServer->setLayout(m_layout);
+    }
+    previous->deleteLater();
+    
+    return true;
 }
 
 void MainWindow::setLayout(const QString& layoutFile) {
@@ -151,6 +206,38 @@ void MainWindow::updateLayoutDisplayName(const QString& layoutFile) {
     }
 }
 
+void MainWindow::reloadConfig(const QString& configFile) {
+    Config* config = Config::instance();
+    const QString previousLayout = config->defaultLayout();
+    // An unreadable file keeps the current settings.
+    config->load(configFile);
+
+    if (config->targetFps() > 0) {
+        m_renderScheduler->setTargetFps(config->targetFps());
+    } else if (QScreen* screen = QGuiApplication::primaryScreen()) {
+        m_renderScheduler->setTargetFps(screen->refreshRate());
+    }
+    m_keyStats->setChordWindow(config->chordWindowMs());
+
+    // Server, storage and hub settings take effect on the next start.
+    if (config->defaultLayout() != previousLayout) {
+        QString layoutPath = QApplication::applicationDirPath() + "/layouts/" + config->defaultLayout() + ".json";
+        if (QFileInfo::exists(layoutPath)) {
+            setLayout(layoutPath);
+        }
+    }
+}
+
+void MainWindow::reloadLayout(const QString& layoutFile) {
+    // Only the layout on screen matters; others are read when selected.
+    if (QFileInfo(layoutFile) != QFileInfo(m_currentLayoutPath)) {
+        return;
+    }
+    if (!loadLayout(layoutFile)) {
+        qWarning() << "Keeping the current layout, failed to reload" << layoutFile;
+    }
+}
+
 void MainWindow::onKeyPressed(int vkCode) {
     if (m_keyboard) {
         m_keyboard->onKeyPressed(vkCode);
@@ -23,14 +23,19 @@
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QPushButton>
-#include "keyboardhook.h"
-#include "mousehook.h"
+#include "inputdispatcher.h"
+#include "hookthread.h"
 #include "keylayout.h"
 #include "virtualkeyboard.h"
+#include "renderscheduler.h"
 #include "keystats.h"
+#include "eventlog.h"
 #include "httpserver.h"
+#include "hubserver.h"
+#include "hubclient.h"
 #include "systray.h"
 #include "previewwindow.h"
+#include "configwatcher.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -57,15 +62,22 @@ private slots:
 private:
     bool loadLayout(const QString& layoutFile);
     void updateLayoutDisplayName(const QString& layoutFile);
+    void reloadConfig(const QString& configFile);
+    void reloadLayout(const QString& layoutFile);
 
-    KeyboardHook* m_keyboardHook = nullptr;
-    MouseHook* m_mouseHook = nullptr;
+    InputDispatcher* m_dispatcher = nullptr;
+    HookThread* m_hookThread = nullptr;
     KeyLayout* m_layout = nullptr;
     VirtualKeyboard* m_keyboard = nullptr;
+    RenderScheduler* m_renderScheduler = nullptr;
     KeyStats* m_keyStats = nullptr;
+    EventLog* m_eventLog = nullptr;
     HttpServer* m_httpServer = nullptr;
+    HubServer* m_hubServer = nullptr;
+    HubClient* m_hubClient = nullptr;
     SysTray* m_sysTray = nullptr;
     PreviewWindow* m_previewWindow = nullptr;
+    ConfigWatcher* m_configWatcher = nullptr;
     QString m_currentLayoutPath;
 };
 
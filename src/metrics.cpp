@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "metrics.h"
+#include <chrono>
+
+namespace {
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+const MetricInfo counterInfo[Metrics::CounterCount] = {
+    { "keystatics_events_ingested_total", "Input events drained from the input ring." },
+    { "keystatics_events_dropped_total", "Input events lost because the input ring was full." },
+    { "keystatics_events_filtered_total", "Key presses ignored because the key is not in the layout." },
+    { "keystatics_bytes_written_total", "Bytes handed to client sockets." },
+    { "keystatics_sse_frames_total", "Server-Sent Events frames written to clients." },
+    { "keystatics_ws_frames_total", "WebSocket frames written to clients." },
+    { "keystatics_push_frames_dropped_total", "Push frames skipped for clients over the high-water mark." },
+    { "keystatics_push_catchups_total", "Keyframes sent to push clients that caught up." },
+    { "keystatics_push_evictions_total", "Push clients disconnected for staying behind too long." },
+    { "keystatics_hub_events_sent_total", "Events forwarded to the hub." },
+    { "keystatics_hub_events_dropped_total", "Events not forwarded because the hub was unreachable or behind." },
+    { "keystatics_hub_events_received_total", "Events merged in from hub nodes." },
+    { "keystatics_layout_cache_hits_total", "Layouts restored from the compiled layout cache." },
+    { "keystatics_layout_cache_misses_total", "Layout files parsed because they were not cached or changed." },
+    { "keystatics_eventlog_lost_total", "Events not written to the event log because no segment could be started." },
+    { "keystatics_timer_wakeups_total", "Internal timer expirations; stays flat while idle." },
+};
+
+const MetricInfo timingInfo[Metrics::TimingCount] = {
+    { "keystatics_hook_callback_seconds", "Time spent in the low-level input hook procedure." },
+    { "keystatics_serialize_seconds", "Time spent serializing push frames." },
+    { "keystatics_broadcast_seconds", "Duration of a broadcast tick." },
+    { "keystatics_paint_seconds", "Time spent painting the overlay window." },
+};
+
+}
+
+Metrics* Metrics::instance() {
+    static Metrics metrics;
+    return &metrics;
+}
+
+qint64 Metrics::now() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Metrics::timing(Timing timing, qint64 startNs) {
+    const quint64 ns = static_cast<quint64>(qMax<qint64>(0, now() - startNs));
+    TimingSlot& slot = m_timings[timing];
+    slot.count.fetch_add(1, std::memory_order_relaxed);
+    slot.sumNs.fetch_add(ns, std::memory_order_relaxed);
+
+    quint64 max = slot.maxNs.load(std::memory_order_relaxed);
+    while (ns > max && !slot.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void Metrics::writeMetrics(QByteArray& out) const {
+    for (int i = 0; i < CounterCount; ++i) {
+        const QByteArray name = counterInfo[i].name;
+        out += "# HELP " + name + " " + counterInfo[i].help + "\n";
+        out += "# TYPE " + name + " counter\n";
+        out += name + " " + QByteArray::number(value(static_cast<Counter>(i))) + "\n";
+    }
+
+    for (int i = 0; i < TimingCount; ++i) {
+        const TimingSlot& slot = m_timings[i];
+        const QByteArray name = timingInfo[i].name;
+        out += "# HELP " + name + " " + timingInfo[i].help + "\n";
+        out += "# TYPE " + name + " summary\n";
+        out += name + "_sum " + QByteArray::number(slot.sumNs.load(std::memory_order_relaxed) / 1e9, 'g', 9) + "\n";
+        out += name + "_count " + QByteArray::number(slot.count.load(std::memory_order_relaxed)) + "\n";
+        out += "# TYPE " + name + "_max gauge\n";
+        out += name + "_max " + QByteArray::number(slot.maxNs.load(std::memory_order_relaxed) / 1e9, 'g', 9) + "\n";
+    }
+}
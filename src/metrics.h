@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <atomic>
+
+// Process-wide counters and timings, cheap enough to leave on: updates are
+// relaxed atomic adds on cache-line separated slots, so the hook thread
+// and the main thread never contend. Rendered in Prometheus text format
+// at /metrics.
+class Metrics {
+public:
+    enum Counter {
+        EventsIngested,     // events drained from the input ring
+        EventsDropped,      // events lost because the ring was full
+        EventsFiltered,     // presses ignored because the key is not in the layout
+        BytesWritten,       // push and HTTP bytes handed to sockets
+        SseFramesSent,
+        WsFramesSent,
+        PushFramesDropped,  // frames skipped for clients over the high-water mark
+        PushCatchUps,       // keyframes sent to clients that drained again
+        PushEvictions,      // clients disconnected for staying stalled
+        HubEventsSent,      // events forwarded to a hub by this node
+        HubEventsDropped,   // events not forwarded because the hub was unreachable or behind
+        HubEventsReceived,  // events merged in from hub nodes
+        LayoutCacheHits,    // layouts restored from the compiled cache
+        LayoutCacheMisses,  // layout files parsed because they were new or changed
+        EventLogLost,       // events not logged because no segment could be started
+        TimerWakeups,       // expirations of the stats, push, render and sync timers
+        CounterCount
+    };
+
+    enum Timing {
+        HookCallback,       // low-level hook procedure
+        Serialize,          // building push frames
+        Broadcast,          // one full broadcast tick
+        Paint,              // VirtualKeyboard::paintEvent
+        TimingCount
+    };
+
+    static Metrics* instance();
+
+    // Monotonic nanoseconds for timing().
+    static qint64 now();
+
+    void add(Counter counter, quint64 n = 1) {
+        m_counters[counter].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    quint64 value(Counter counter) const {
+        return m_counters[counter].value.load(std::memory_order_relaxed);
+    }
+    void timing(Timing timing, qint64 startNs);
+
+    void writeMetrics(QByteArray& out) const;
+
+private:
+    Metrics() = default;
+
+    struct alignas(64) CounterSlot {
+        std::atomic<quint64> value{0};
+    };
+    struct alignas(64) TimingSlot {
+        std::atomic<quint64> count{0};
+        std::atomic<quint64> sumNs{0};
+        std::atomic<quint64> maxNs{0};
+    };
+
+    CounterSlot m_counters[CounterCount];
+    TimingSlot m_timings[TimingCount];
+};
+
+#endif
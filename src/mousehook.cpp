@@ -15,12 +15,21 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "mousehook.h"
+#include "latency.h"
+#include "metrics.h"
 #include <QDebug>
 
-MouseHook* MouseHook::s_instance = nullptr;
+thread_local MouseHook* MouseHook::s_instance = nullptr;
+
+// Traced only for events that are posted, so the histogram describes the
+// presses and releases the overlay shows.
+static void recordDelivery(DWORD eventTime) {
+    Latency::instance()->recordUs(Latency::HookDelivery,
+        static_cast<quint64>(static_cast<quint32>(GetTickCount() - eventTime)) * 1000);
+}
 
 MouseHook::MouseHook(QObject* parent)
-    : QObject(parent)
+    : InputSource(parent)
 {
     s_instance = this;
 }
@@ -57,9 +66,18 @@ void MouseHook::stop() {
 }
 
 LRESULT CALLBACK MouseHook::lowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam) {
-    if (nCode == HC_ACTION) {
+    // Moves are the bulk of mouse traffic and are never posted, so they
+    // pass through before any clock is read.
+    if (nCode == HC_ACTION && wParam != WM_MOUSEMOVE) {
         if (s_instance) {
+            const qint64 startNs = Metrics::now();
+            const quint32 stamp = Latency::stamp();
             MSLLHOOKSTRUCT* pMouse = reinterpret_cast<MSLLHOOKSTRUCT*>(lParam);
+
+            InputEvent event;
+            event.time = pMouse->time;
+            event.stamp = stamp;
+            event.source = InputEvent::Mouse;
             
             int vkCode = 0;
             switch (wParam) {
@@ -83,17 +101,22 @@ LRESULT CALLBACK MouseHook::lowLevelMouseProc(int nCode, WPARAM wParam, LPARAM l
             case WM_MOUSEHWHEEL:
                 {
                     int delta = GET_WHEEL_DELTA_WPARAM(pMouse->mouseData);
-                    if (delta > 0) {
-                        emit s_instance->wheelScrolled(1);
-                    } else if (delta < 0) {
-                        emit s_instance->wheelScrolled(-1);
+                    if (delta != 0) {
+                        event.vkCode = 0;
+                        event.type = delta > 0 ? InputEvent::WheelUp : InputEvent::WheelDown;
+                        recordDelivery(pMouse->time);
+                        s_instance->post(event);
                     }
                 }
+                Metrics::instance()->timing(Metrics::HookCallback, startNs);
                 return CallNextHookEx(nullptr, nCode, wParam, lParam);
             default:
+                Metrics::instance()->timing(Metrics::HookCallback, startNs);
                 return CallNextHookEx(nullptr, nCode, wParam, lParam);
             }
             
+            event.vkCode = static_cast<quint16>(vkCode);
+
             switch (wParam) {
             case WM_LBUTTONDOWN:
             case WM_RBUTTONDOWN:
@@ -101,7 +124,9 @@ LRESULT CALLBACK MouseHook::lowLevelMouseProc(int nCode, WPARAM wParam, LPARAM l
             case WM_XBUTTONDOWN:
                 if (!s_instance->m_pressedButtons.contains(vkCode)) {
                     s_instance->m_pressedButtons.insert(vkCode);
-                    emit s_instance->buttonPressed(vkCode);
+                    event.type = InputEvent::Press;
+                    recordDelivery(pMouse->time);
+                    s_instance->post(event);
                 }
                 break;
                 
@@ -111,10 +136,13 @@ LRESULT CALLBACK MouseHook::lowLevelMouseProc(int nCode, WPARAM wParam, LPARAM l
             case WM_XBUTTONUP:
                 if (s_instance->m_pressedButtons.contains(vkCode)) {
                     s_instance->m_pressedButtons.remove(vkCode);
-                    emit s_instance->buttonReleased(vkCode);
+                    event.type = InputEvent::Release;
+                    recordDelivery(pMouse->time);
+                    s_instance->post(event);
                 }
                 break;
             }
+            Metrics::instance()->timing(Metrics::HookCallback, startNs);
         }
     }
     return CallNextHookEx(nullptr, nCode, wParam, lParam);
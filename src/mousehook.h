@@ -18,33 +18,30 @@
 #define MOUSEHOOK_H
 
 #include <QObject>
-#include <QSet>
 #include <Windows.h>
+#include "inputsource.h"
+#include "vkbitmap.h"
 
-class MouseHook : public QObject {
+class MouseHook : public InputSource {
     Q_OBJECT
 
 public:
     explicit MouseHook(QObject* parent = nullptr);
     ~MouseHook();
     
-    bool start();
-    void stop();
+    bool start() override;
+    void stop() override;
     
-    const QSet<int>& pressedButtons() const { return m_pressedButtons; }
-
-signals:
-    void buttonPressed(int vkCode);
-    void buttonReleased(int vkCode);
-    void wheelScrolled(int delta);
+    const VkBitmap& pressedButtons() const { return m_pressedButtons; }
 
 private:
-    static MouseHook* s_instance;
+    // Low-level hooks are called on the thread that installed them.
+    static thread_local MouseHook* s_instance;
     static LRESULT CALLBACK lowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam);
     
     HHOOK m_hook = nullptr;
     bool m_running = false;
-    QSet<int> m_pressedButtons;
+    VkBitmap m_pressedButtons;
 };
 
 #endif
@@ -55,13 +55,11 @@ PreviewWindow::PreviewWindow(QWidget* parent)
     
     setCentralWidget(centralWidget);
     
-    m_keyboardHook = new KeyboardHook(this);
-    connect(m_keyboardHook, &KeyboardHook::keyPressed, this, &PreviewWindow::onKeyPressed);
-    connect(m_keyboardHook, &KeyboardHook::keyReleased, this, &PreviewWindow::onKeyReleased);
-    
-    m_mouseHook = new MouseHook(this);
-    connect(m_mouseHook, &MouseHook::buttonPressed, this, &PreviewWindow::onMousePressed);
-    connect(m_mouseHook, &MouseHook::buttonReleased, this, &PreviewWindow::onMouseReleased);
+    m_dispatcher = new InputDispatcher(this);
+    connect(m_dispatcher, &InputDispatcher::keyPressed, this, &PreviewWindow::onKeyPressed);
+    connect(m_dispatcher, &InputDispatcher::keyReleased, this, &PreviewWindow::onKeyReleased);
+    connect(m_dispatcher, &InputDispatcher::buttonPressed, this, &PreviewWindow::onMousePressed);
+    connect(m_dispatcher, &InputDispatcher::buttonReleased, this, &PreviewWindow::onMouseReleased);
     
     connect(m_layoutCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), 
             this, &PreviewWindow::onLayoutChanged);
@@ -70,21 +68,14 @@ PreviewWindow::PreviewWindow(QWidget* parent)
     
     loadLayouts();
     
-    if (m_keyboardHook->start()) {
-        qDebug() << "Preview: keyboard hook started";
-    }
-    
-    if (m_mouseHook->start()) {
-        qDebug() << "Preview: mouse hook started";
-    }
+    m_hookThread = new HookThread(m_dispatcher, this);
+    m_hookThread->start();
+    qDebug() << "Preview: input hooks started";
 }
 
 PreviewWindow::~PreviewWindow() {
-    if (m_keyboardHook) {
-        m_keyboardHook->stop();
-    }
-    if (m_mouseHook) {
-        m_mouseHook->stop();
+    if (m_hookThread) {
+        m_hookThread->stop();
     }
 }
 
@@ -110,7 +101,7 @@ void PreviewWindow::loadSelectedLayout() {
     int index = m_layoutCombo->currentIndex();
     if (index >= 0 && index < m_layoutFiles.size()) {
         QString layoutFile = m_layoutFiles[index];
-        if (m_layout->loadFromFile(layoutFile)) {
+        if (m_layout->loadFromCache(layoutFile)) {
             m_keyboard->setLayout(m_layout);
             adjustSize();
             
@@ -20,8 +20,8 @@
 #include <QMainWindow>
 #include <QComboBox>
 #include <QPushButton>
-#include "keyboardhook.h"
-#include "mousehook.h"
+#include "inputdispatcher.h"
+#include "hookthread.h"
 #include "keylayout.h"
 #include "virtualkeyboard.h"
 
@@ -48,8 +48,8 @@ private:
     QPushButton* m_resetButton = nullptr;
     QPushButton* m_closeButton = nullptr;
     
-    KeyboardHook* m_keyboardHook = nullptr;
-    MouseHook* m_mouseHook = nullptr;
+    InputDispatcher* m_dispatcher = nullptr;
+    HookThread* m_hookThread = nullptr;
     KeyLayout* m_layout = nullptr;
     VirtualKeyboard* m_keyboard = nullptr;
     
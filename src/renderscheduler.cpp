@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "renderscheduler.h"
+#include "metrics.h"
+#include <QDebug>
+
+RenderScheduler::RenderScheduler(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &RenderScheduler::onFrame);
+
+    setTargetFps(m_targetFps);
+}
+
+void RenderScheduler::setTargetFps(double fps) {
+    if (fps <= 0) {
+        fps = 60.0;
+    }
+    m_targetFps = fps;
+    m_intervalNs = static_cast<qint64>(1e9 / fps);
+    qDebug() << "Render scheduler target:" << fps << "fps";
+}
+
+void RenderScheduler::markDirty(int vkCode) {
+    if (VkBitmap::isValid(vkCode)) {
+        m_dirty.insert(vkCode);
+    }
+    ++m_pendingEvents;
+    if (!m_timer->isActive()) {
+        scheduleFrame();
+    }
+}
+
+// The next frame is the next grid boundary, so frames keep a steady
+// cadence regardless of when the first event of a burst arrived.
+void RenderScheduler::scheduleFrame() {
+    const qint64 now = m_clock.nsecsElapsed();
+    m_frameDueNs = (now / m_intervalNs + 1) * m_intervalNs;
+    const qint64 delayNs = m_frameDueNs - now;
+    m_timer->start(static_cast<int>((delayNs + 999999) / 1000000));
+}
+
+void RenderScheduler::onFrame() {
+    Metrics::instance()->add(Metrics::TimerWakeups);
+    // A frame that fires a whole interval late means the grid slots in
+    // between were missed.
+    const qint64 lateNs = m_clock.nsecsElapsed() - m_frameDueNs;
+    if (lateNs >= m_intervalNs) {
+        m_droppedFrames += static_cast<quint64>(lateNs / m_intervalNs);
+    }
+
+    ++m_frames;
+    m_events += m_pendingEvents;
+    m_maxEventsPerFrame = qMax(m_maxEventsPerFrame, m_pendingEvents);
+    m_pendingEvents = 0;
+
+    const VkBitmap dirty = m_dirty;
+    m_dirty.clear();
+    emit frame(dirty);
+}
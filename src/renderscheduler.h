@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "vkbitmap.h"
+
+// Collects keys whose on-screen state changed and hands them out once per
+// frame. Frames sit on a fixed grid at the target rate, so a burst of
+// events between two frames costs a single repaint. The timer only runs
+// while something is dirty.
+class RenderScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    explicit RenderScheduler(QObject* parent = nullptr);
+
+    void setTargetFps(double fps);
+    double targetFps() const { return m_targetFps; }
+
+    void markDirty(int vkCode);
+
+    quint64 frames() const { return m_frames; }
+    quint64 droppedFrames() const { return m_droppedFrames; }
+    quint64 events() const { return m_events; }
+    int maxEventsPerFrame() const { return m_maxEventsPerFrame; }
+    double eventsPerFrame() const { return m_frames ? double(m_events) / m_frames : 0.0; }
+
+signals:
+    void frame(const VkBitmap& dirtyKeys);
+
+private slots:
+    void onFrame();
+
+private:
+    void scheduleFrame();
+
+    QTimer* m_timer = nullptr;
+    QElapsedTimer m_clock;
+    double m_targetFps = 60.0;
+    qint64 m_intervalNs = 0;
+    qint64 m_frameDueNs = 0;
+    VkBitmap m_dirty;
+    int m_pendingEvents = 0;
+
+    quint64 m_frames = 0;
+    quint64 m_droppedFrames = 0;
+    quint64 m_events = 0;
+    int m_maxEventsPerFrame = 0;
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "replaysource.h"
+#include "latency.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+ReplaySource::ReplaySource(QObject* parent)
+    : InputSource(parent)
+{
+    m_syntheticKeys = {68, 70, 74, 75};
+}
+
+ReplaySource::~ReplaySource() {
+    stop();
+}
+
+bool ReplaySource::loadFile(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Failed to open replay file:" << filePath;
+        return false;
+    }
+
+    QList<InputEvent> events;
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
+        bool timeOk = false;
+        bool vkOk = false;
+        InputEvent event;
+        event.time = parts.size() >= 3 ? parts[0].toUInt(&timeOk) : 0;
+        int vkCode = parts.size() >= 3 ? parts[1].toInt(&vkOk) : 0;
+        if (!timeOk || !vkOk || vkCode < 0 || vkCode > 255
+            || (parts[2] != "down" && parts[2] != "up")) {
+            qWarning() << "Invalid replay event at" << filePath << "line" << lineNumber;
+            return false;
+        }
+
+        event.vkCode = static_cast<quint16>(vkCode);
+        event.type = parts[2] == "down" ? InputEvent::Press : InputEvent::Release;
+        event.source = parts.size() > 3 && parts[3] == "mouse" ? InputEvent::Mouse : InputEvent::Keyboard;
+        events.append(event);
+    }
+
+    m_recorded = events;
+    qDebug() << "Loaded replay:" << filePath << "with" << m_recorded.size() << "events";
+    return true;
+}
+
+void ReplaySource::setSyntheticKeys(const QList<int>& vkCodes) {
+    m_syntheticKeys = vkCodes;
+    m_recorded.clear();
+}
+
+bool ReplaySource::start() {
+    if (m_thread) {
+        return true;
+    }
+    if (!m_dispatcher) {
+        qWarning() << "Replay source has no dispatcher";
+        return false;
+    }
+    if (m_recorded.isEmpty() && m_syntheticKeys.isEmpty()) {
+        qWarning() << "Replay source has nothing to play";
+        return false;
+    }
+
+    m_stopRequested.store(false, std::memory_order_relaxed);
+    m_produced.store(0, std::memory_order_relaxed);
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("ReplaySource");
+    m_thread->start();
+    return true;
+}
+
+void ReplaySource::stop() {
+    if (!m_thread) {
+        return;
+    }
+    m_stopRequested.store(true, std::memory_order_relaxed);
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+bool ReplaySource::deliver(const InputEvent& event) {
+    if (!m_blocking) {
+        post(event);
+        return true;
+    }
+    while (!m_dispatcher->tryPush(event)) {
+        if (m_stopRequested.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        QThread::yieldCurrentThread();
+    }
+    return true;
+}
+
+void ReplaySource::run() {
+    QElapsedTimer clock;
+    clock.start();
+
+    const bool recorded = !m_recorded.isEmpty();
+    const qint64 intervalNs = m_rate > 0 ? static_cast<qint64>(1e9 / m_rate) : 0;
+    const qint64 recordingStart = recorded ? m_recorded.first().time : 0;
+    const qint64 recordingSpan = recorded ? m_recorded.last().time - recordingStart + 1 : 0;
+
+    quint64 produced = 0;
+    int index = 0;
+    qint64 loopOffsetMs = 0;
+
+    while (!m_stopRequested.load(std::memory_order_relaxed)) {
+        if (m_eventLimit > 0 && produced >= m_eventLimit) {
+            break;
+        }
+
+        InputEvent event;
+        qint64 dueNs = static_cast<qint64>(produced) * intervalNs;
+
+        if (recorded) {
+            if (index == m_recorded.size()) {
+                if (!m_loop) {
+                    break;
+                }
+                index = 0;
+                loopOffsetMs += recordingSpan;
+            }
+            event = m_recorded[index++];
+            qint64 offsetMs = event.time - recordingStart + loopOffsetMs;
+            if (intervalNs == 0) {
+                dueNs = offsetMs * 1000000;
+            }
+            event.time = static_cast<quint32>(recordingStart + offsetMs);
+        } else {
+            // Alternate press/release over the synthetic key set.
+            event.vkCode = static_cast<quint16>(m_syntheticKeys[(produced / 2) % m_syntheticKeys.size()]);
+            event.type = produced % 2 == 0 ? InputEvent::Press : InputEvent::Release;
+            event.source = InputEvent::Keyboard;
+            event.time = static_cast<quint32>(clock.elapsed());
+        }
+
+        if (dueNs > 0) {
+            // Sleep only when more than a millisecond ahead; within that,
+            // events go out in small bursts that keep the average rate.
+            qint64 aheadNs = dueNs - clock.nsecsElapsed();
+            if (aheadNs > 1000000) {
+                QThread::usleep(static_cast<unsigned long>(aheadNs / 1000));
+            }
+        }
+
+        event.stamp = Latency::stamp();
+        if (!deliver(event)) {
+            break;
+        }
+        ++produced;
+        m_produced.store(produced, std::memory_order_relaxed);
+    }
+
+    emit finished();
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <QList>
+#include <QThread>
+#include <atomic>
+#include "inputsource.h"
+
+// Feeds a recorded or generated event stream into the dispatcher from its
+// own producer thread, paced at a configurable rate. Used to load-test the
+// stats and broadcast paths without the Win32 hooks.
+//
+// Recording format: one event per line, "<timeMs> <vkCode> <down|up> [mouse]".
+// Lines starting with '#' are ignored.
+class ReplaySource : public InputSource {
+    Q_OBJECT
+
+public:
+    explicit ReplaySource(QObject* parent = nullptr);
+    ~ReplaySource() override;
+
+    bool loadFile(const QString& filePath);
+    void setSyntheticKeys(const QList<int>& vkCodes);
+
+    // Events per second. 0 replays recordings with their original timing
+    // and generates synthetic events as fast as the ring accepts them.
+    void setRate(double eventsPerSecond) { m_rate = eventsPerSecond; }
+    void setEventLimit(quint64 count) { m_eventLimit = count; }
+    void setLoop(bool loop) { m_loop = loop; }
+    // Wait for ring space instead of dropping when the consumer falls behind.
+    void setBlocking(bool blocking) { m_blocking = blocking; }
+
+    bool start() override;
+    void stop() override;
+
+    quint64 eventsProduced() const { return m_produced.load(std::memory_order_relaxed); }
+
+signals:
+    void finished();
+
+private:
+    void run();
+    bool deliver(const InputEvent& event);
+
+    QList<InputEvent> m_recorded;
+    QList<int> m_syntheticKeys;
+    double m_rate = 0;
+    quint64 m_eventLimit = 0;
+    bool m_loop = false;
+    bool m_blocking = true;
+
+    QThread* m_thread = nullptr;
+    std::atomic<bool> m_stopRequested{false};
+    std::atomic<quint64> m_produced{0};
+};
+
+#endif
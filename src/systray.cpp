@@ -22,6 +22,7 @@
 #include <QDebug>
 #include <QIcon>
 #include <QDir>
+#include <QFileInfo>
 #include <QMessageBox>
 
 #include "config.h"
@@ -60,33 +61,17 @@ void SysTray::createMenu() {
     m_menu = new QMenu();
     m_layoutActions.clear();
     
-    QMenu* layoutMenu = new QMenu("Switch Layout", m_menu);
+    m_layoutMenu = new QMenu("Switch Layout", m_menu);
     
     QString layoutDir = QApplication::applicationDirPath() + "/layouts";
     QDir dir(layoutDir);
-    QStringList jsonFiles = dir.entryList(QStringList() << "*.json", QDir::Files | QDir::Readable);
-
-    if (jsonFiles.isEmpty()) {
-        QString defaultFile = layoutDir + "/104keys.json";
-        QFile file(defaultFile);
-        if (!file.exists()) {
-            qWarning() << "No layout files found!";
-        }
-    } else {
-        for (const QString& fileName : jsonFiles) {
-            QString fullPath = layoutDir + "/" + fileName;
-            QAction* action = new QAction(fileName, this);
-            connect(action, &QAction::triggered, this, [this, fullPath, fileName]() {
-                m_mainWindow->setLayout(fullPath);
-                updateCurrentLayout(fileName);
-                emit layoutChanged(fullPath);
-            });
-            m_layoutActions[fileName] = action;
-            layoutMenu->addAction(action);
-        }
+    QStringList layoutFiles;
+    for (const QString& fileName : dir.entryList(QStringList() << "*.json", QDir::Files | QDir::Readable)) {
+        layoutFiles.append(dir.absoluteFilePath(fileName));
     }
+    setLayoutFiles(layoutFiles);
     
-    m_menu->addMenu(layoutMenu);
+    m_menu->addMenu(m_layoutMenu);
     m_menu->addSeparator();
     
     m_currentLayoutAction = new QAction("Current: --", this);
@@ -120,6 +105,28 @@ void SysTray::createMenu() {
     m_menu->addAction(exitAction);
 }
 
+void SysTray::setLayoutFiles(const QStringList& filePaths) {
+    qDeleteAll(m_layoutActions);
+    m_layoutActions.clear();
+    m_layoutMenu->clear();
+
+    if (filePaths.isEmpty()) {
+        qWarning() << "No layout files found!";
+    }
+    for (const QString& fullPath : filePaths) {
+        const QString fileName = QFileInfo(fullPath).fileName();
+        QAction* action = new QAction(fileName, this);
+        connect(action, &QAction::triggered, this, [this, fullPath, fileName]() {
+            m_mainWindow->setLayout(fullPath);
+            updateCurrentLayout(fileName);
+            emit layoutChanged(fullPath);
+        });
+        m_layoutActions[fileName] = action;
+        m_layoutMenu->addAction(action);
+    }
+    refreshMenu();
+}
+
 void SysTray::refreshMenu() {
     for (auto it = m_layoutActions.constBegin(); it != m_layoutActions.constEnd(); ++it) {
         QString fileName = it.key();
@@ -35,6 +35,9 @@ public:
     void updateCurrentLayout(const QString& layoutName);
     void updateKeyboardVisible(bool visible);
     void refreshMenu();
+    // Replaces the Switch Layout entries, e.g. after files were added or
+    // removed in the layouts directory.
+    void setLayoutFiles(const QStringList& filePaths);
 
 signals:
     void layoutChanged(const QString& layoutName);
@@ -56,6 +59,7 @@ private:
     MainWindow* m_mainWindow = nullptr;
     QSystemTrayIcon* m_trayIcon = nullptr;
     QMenu* m_menu = nullptr;
+    QMenu* m_layoutMenu = nullptr;
     QString m_currentLayout;
     bool m_keyboardVisible = false;
     QMap<QString, QAction*> m_layoutActions;
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "transitionstats.h"
+#include <algorithm>
+
+namespace {
+
+// Tables stop taking new entries at three quarters full so probes stay short.
+bool tableFull(int used, int slotCount) {
+    return used >= slotCount / 4 * 3;
+}
+
+int slotFor(quint64 key, int slotCount) {
+    return static_cast<int>((key * Q_UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (slotCount - 1);
+}
+
+}
+
+TransitionStats::TransitionStats() {
+    m_matrix.fill(0, KeyCount * KeyCount);
+    m_activeCells.reserve(KeyCount * KeyCount);
+    m_intervals.resize(IntervalSlotCount);
+    m_chords.resize(ChordSlotCount);
+}
+
+void TransitionStats::recordPress(int vkCode, qint64 timeMs) {
+    if (m_previousVk >= 0 && timeMs - m_previousMs <= MaxIntervalMs) {
+        const quint32 cell = static_cast<quint32>(m_previousVk * KeyCount + vkCode);
+        if (m_matrix[cell]++ == 0) {
+            m_activeCells.append(static_cast<quint16>(cell));
+        }
+        ++m_totalTransitions;
+        if (LogHistogram* intervals = intervalsFor(cell, true)) {
+            intervals->record(static_cast<quint32>(timeMs - m_previousMs));
+        }
+    }
+    m_previousVk = vkCode;
+    m_previousMs = timeMs;
+
+    if (m_chordSize > 0 && timeMs - m_chordStartMs <= m_chordWindowMs) {
+        // Repeats of a key already in the group and keys past the eighth
+        // do not change the chord.
+        for (int i = 0; i < m_chordSize; ++i) {
+            if (m_chordKeys[i] == vkCode) return;
+        }
+        if (m_chordSize < MaxChordKeys) {
+            m_chordKeys[m_chordSize++] = static_cast<quint8>(vkCode);
+        }
+        return;
+    }
+    closeChord();
+    m_chordKeys[0] = static_cast<quint8>(vkCode);
+    m_chordSize = 1;
+    m_chordStartMs = timeMs;
+}
+
+void TransitionStats::reset() {
+    for (quint16 cell : m_activeCells) {
+        m_matrix[cell] = 0;
+    }
+    m_activeCells.clear();
+    if (m_intervalSlotsUsed) {
+        std::fill(m_intervals.begin(), m_intervals.end(), IntervalSlot());
+        m_intervalSlotsUsed = 0;
+    }
+    if (m_chordSlotsUsed) {
+        std::fill(m_chords.begin(), m_chords.end(), ChordSlot());
+        m_chordSlotsUsed = 0;
+    }
+    m_totalTransitions = 0;
+    m_closedChords = 0;
+    m_previousVk = -1;
+    m_chordSize = 0;
+}
+
+LogHistogram* TransitionStats::intervalsFor(quint32 cell, bool insert) {
+    for (int slot = slotFor(cell, IntervalSlotCount);; slot = (slot + 1) & (IntervalSlotCount - 1)) {
+        IntervalSlot& entry = m_intervals[slot];
+        if (entry.cell == cell) return &entry.histogram;
+        if (entry.cell == EmptyCell) {
+            if (!insert || tableFull(m_intervalSlotsUsed, IntervalSlotCount)) return nullptr;
+            entry.cell = cell;
+            ++m_intervalSlotsUsed;
+            return &entry.histogram;
+        }
+    }
+}
+
+const LogHistogram* TransitionStats::intervalsFor(quint32 cell) const {
+    for (int slot = slotFor(cell, IntervalSlotCount);; slot = (slot + 1) & (IntervalSlotCount - 1)) {
+        const IntervalSlot& entry = m_intervals[slot];
+        if (entry.cell == cell) return &entry.histogram;
+        if (entry.cell == EmptyCell) return nullptr;
+    }
+}
+
+quint64 TransitionStats::chordKey() const {
+    quint8 keys[MaxChordKeys];
+    std::copy(m_chordKeys, m_chordKeys + m_chordSize, keys);
+    std::sort(keys, keys + m_chordSize);
+    quint64 key = 0;
+    for (int i = m_chordSize - 1; i >= 0; --i) {
+        key = (key << 8) | keys[i];
+    }
+    return key;
+}
+
+void TransitionStats::closeChord() {
+    if (m_chordSize < 2) return;
+    ++m_closedChords;
+
+    // Two distinct keys never pack to 0, so 0 marks an empty slot.
+    const quint64 key = chordKey();
+    for (int slot = slotFor(key, ChordSlotCount);; slot = (slot + 1) & (ChordSlotCount - 1)) {
+        ChordSlot& entry = m_chords[slot];
+        if (entry.keys == key) {
+            ++entry.count;
+            return;
+        }
+        if (entry.keys == 0) {
+            if (tableFull(m_chordSlotsUsed, ChordSlotCount)) return;
+            entry.keys = key;
+            entry.count = 1;
+            ++m_chordSlotsUsed;
+            return;
+        }
+    }
+}
+
+quint64 TransitionStats::totalChords() const {
+    return m_closedChords + (m_chordSize >= 2 ? 1 : 0);
+}
+
+QVector<TransitionStats::Transition> TransitionStats::topTransitions(int n) const {
+    QVector<quint16> cells = m_activeCells;
+    n = qBound(0, n, cells.size());
+    auto byCount = [this](quint16 a, quint16 b) {
+        return m_matrix[a] != m_matrix[b] ? m_matrix[a] > m_matrix[b] : a < b;
+    };
+    std::partial_sort(cells.begin(), cells.begin() + n, cells.end(), byCount);
+
+    QVector<Transition> result;
+    result.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        Transition transition;
+        transition.from = cells[i] / KeyCount;
+        transition.to = cells[i] % KeyCount;
+        transition.count = m_matrix[cells[i]];
+        transition.intervals = intervalsFor(cells[i]);
+        result.append(transition);
+    }
+    return result;
+}
+
+QVector<TransitionStats::Chord> TransitionStats::topChords(int n) const {
+    const quint64 pending = m_chordSize >= 2 ? chordKey() : 0;
+    QVector<ChordSlot> chords;
+    chords.reserve(m_chordSlotsUsed + 1);
+    bool pendingSeen = false;
+    for (const ChordSlot& entry : m_chords) {
+        if (entry.keys == 0) continue;
+        ChordSlot chord = entry;
+        if (chord.keys == pending) {
+            ++chord.count;
+            pendingSeen = true;
+        }
+        chords.append(chord);
+    }
+    if (pending && !pendingSeen) {
+        chords.append({ pending, 1 });
+    }
+
+    n = qBound(0, n, chords.size());
+    std::partial_sort(chords.begin(), chords.begin() + n, chords.end(),
+                      [](const ChordSlot& a, const ChordSlot& b) {
+                          return a.count != b.count ? a.count > b.count : a.keys < b.keys;
+                      });
+
+    QVector<Chord> result;
+    result.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        Chord chord;
+        chord.count = chords[i].count;
+        for (quint64 keys = chords[i].keys; keys; keys >>= 8) {
+            chord.keys[chord.size++] = static_cast<quint8>(keys & 0xFF);
+        }
+        result.append(chord);
+    }
+    return result;
+}
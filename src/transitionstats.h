@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TRANSITIONSTATS_H
+#define TRANSITIONSTATS_H
+
+#include <QtGlobal>
+#include <QVector>
+#include "vkbitmap.h"
+#include "loghistogram.h"
+
+// Bigram and chord statistics over the press stream.
+//
+// Every press following another within MaxIntervalMs counts as a transition
+// previous vk -> vk in a dense 256x256 matrix, and its interval goes into a
+// LogHistogram kept per transition in a fixed open-addressing table. Presses
+// landing within the chord window of the first press of a group form a
+// chord, counted by its (sorted) key set in a second fixed table. All
+// storage is allocated up front, so recordPress() never allocates.
+class TransitionStats {
+public:
+    static constexpr int KeyCount = VkBitmap::Size;
+    static constexpr int MaxIntervalMs = 2000;     // longer pauses start a new sequence
+    static constexpr int IntervalSlotCount = 4096; // power of two
+    static constexpr int ChordSlotCount = 1024;    // power of two
+    static constexpr int MaxChordKeys = 8;
+
+    struct Transition {
+        int from = 0;
+        int to = 0;
+        quint32 count = 0;
+        const LogHistogram* intervals = nullptr;  // null if the table was full
+    };
+
+    struct Chord {
+        quint8 keys[MaxChordKeys] = {};
+        int size = 0;
+        quint32 count = 0;
+    };
+
+    TransitionStats();
+
+    // vkCode must already be range-checked; times are monotonic ms.
+    void recordPress(int vkCode, qint64 timeMs);
+    void reset();
+
+    void setChordWindow(int ms) { m_chordWindowMs = qMax(0, ms); }
+    int chordWindow() const { return m_chordWindowMs; }
+
+    quint32 count(int from, int to) const { return m_matrix[from * KeyCount + to]; }
+    quint64 totalTransitions() const { return m_totalTransitions; }
+    int distinctTransitions() const { return m_activeCells.size(); }
+    quint64 totalChords() const;
+
+    // Most frequent first. The chord still being formed is included once it
+    // has two keys.
+    QVector<Transition> topTransitions(int n) const;
+    QVector<Chord> topChords(int n) const;
+
+private:
+    struct IntervalSlot {
+        quint32 cell = EmptyCell;
+        LogHistogram histogram;
+    };
+
+    struct ChordSlot {
+        quint64 keys = 0;   // sorted vk codes, one per byte, lowest first; 0 if empty
+        quint32 count = 0;
+    };
+
+    static constexpr quint32 EmptyCell = 0xFFFFFFFF;
+
+    LogHistogram* intervalsFor(quint32 cell, bool insert);
+    const LogHistogram* intervalsFor(quint32 cell) const;
+    quint64 chordKey() const;
+    void closeChord();
+
+    QVector<quint32> m_matrix;          // from * KeyCount + to
+    QVector<quint16> m_activeCells;     // cells with a non-zero count
+    QVector<IntervalSlot> m_intervals;
+    int m_intervalSlotsUsed = 0;
+    QVector<ChordSlot> m_chords;
+    int m_chordSlotsUsed = 0;
+
+    quint64 m_totalTransitions = 0;
+    quint64 m_closedChords = 0;
+    int m_previousVk = -1;
+    qint64 m_previousMs = 0;
+
+    int m_chordWindowMs = 30;
+    quint8 m_chordKeys[MaxChordKeys] = {};
+    int m_chordSize = 0;
+    qint64 m_chordStartMs = 0;
+};
+
+#endif
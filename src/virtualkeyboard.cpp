@@ -16,7 +16,9 @@
  */
 #include "virtualkeyboard.h"
 #include <QPainter>
+#include <QPaintEvent>
 #include <QDebug>
+#include "metrics.h"
 
 VirtualKeyboard::VirtualKeyboard(QWidget* parent)
     : QWidget(parent)
@@ -29,86 +31,158 @@ VirtualKeyboard::VirtualKeyboard(QWidget* parent)
 }
 
 QSize VirtualKeyboard::sizeHint() const {
-    if (m_layout && m_layout->keys().size() > 0) {
-        int maxX = 0, maxY = 0;
-        auto it = m_layout->keys().constBegin();
-        while (it != m_layout->keys().constEnd()) {
-            const KeyInfo& info = it.value();
-            maxX = qMax(maxX, info.geometry.right() + 20);
-            maxY = qMax(maxY, info.geometry.bottom() + 20);
-            ++it;
-        }
-        return QSize(maxX + 30, maxY + 30);
+    if (m_layout && !m_layout->keys().empty()) {
+        const QRect& bounds = m_layout->bounds();
+        return QSize(qMax(0, bounds.right() + 20) + 30, qMax(0, bounds.bottom() + 20) + 30);
     }
     return QSize(800, 400);
 }
 
 void VirtualKeyboard::setLayout(KeyLayout* layout) {
     m_layout = layout;
-    if (m_layout && m_layout->keys().size() > 0) {
-        int maxX = 0, maxY = 0;
-        auto it = m_layout->keys().constBegin();
-        while (it != m_layout->keys().constEnd()) {
-            const KeyInfo& info = it.value();
-            maxX = qMax(maxX, info.geometry.right() + 10);
-            maxY = qMax(maxY, info.geometry.bottom() + 10);
-            ++it;
-        }
-        int w = maxX + 30;
-        int h = maxY + 30;
+    if (m_layout && !m_layout->keys().empty()) {
+        const QRect& bounds = m_layout->bounds();
+        int w = qMax(0, bounds.right() + 10) + 30;
+        int h = qMax(0, bounds.bottom() + 10) + 30;
         resize(w, h);
     }
+    m_sprites.clear();
+    m_spriteDpr = 0;
     update();
 }
 
+void VirtualKeyboard::setRenderScheduler(RenderScheduler* scheduler) {
+    if (m_scheduler) {
+        disconnect(m_scheduler, nullptr, this, nullptr);
+    }
+    m_scheduler = scheduler;
+    if (m_scheduler) {
+        connect(m_scheduler, &RenderScheduler::frame, this, &VirtualKeyboard::repaintKeys);
+    }
+}
+
 void VirtualKeyboard::onKeyPressed(int vkCode) {
-    m_pressedKeys.insert(vkCode);
     if (m_keyCounts.contains(vkCode)) {
         m_keyCounts[vkCode]++;
     } else {
         m_keyCounts[vkCode] = 1;
     }
-    update();
+    if (!m_pressedKeys.contains(vkCode)) {
+        m_pressedKeys.insert(vkCode);
+        updateKey(vkCode);
+    }
 }
 
 void VirtualKeyboard::onKeyReleased(int vkCode) {
-    m_pressedKeys.remove(vkCode);
-    update();
+    if (m_pressedKeys.remove(vkCode)) {
+        updateKey(vkCode);
+    }
 }
 
 void VirtualKeyboard::updatePressedKeys(const QSet<int>& keys) {
+    for (int vk : m_pressedKeys) {
+        if (!keys.contains(vk)) {
+            updateKey(vk);
+        }
+    }
+    for (int vk : keys) {
+        if (!m_pressedKeys.contains(vk)) {
+            updateKey(vk);
+        }
+    }
     m_pressedKeys = keys;
-    update();
 }
 
-void VirtualKeyboard::paintEvent(QPaintEvent* event) {
-    Q_UNUSED(event);
-    QPainter painter(this);
+void VirtualKeyboard::repaintKeys(const VkBitmap& keys) {
+    if (!m_layout) return;
+    const std::vector<KeyInfo>& layoutKeys = m_layout->keys();
+    for (int vk : keys) {
+        for (int index : m_layout->keysFor(vk)) {
+            update(spriteRect(layoutKeys[index]));
+        }
+    }
+}
+
+void VirtualKeyboard::updateKey(int vkCode) {
+    if (m_scheduler) {
+        m_scheduler->markDirty(vkCode);
+        return;
+    }
+    if (!m_layout) return;
+    for (int index : m_layout->keysFor(vkCode)) {
+        update(spriteRect(m_layout->keys()[index]));
+    }
+}
+
+QRect VirtualKeyboard::spriteRect(const KeyInfo& info) const {
+    return info.geometry.translated(KeyOffset, KeyOffset)
+        .adjusted(-SpriteMargin, -SpriteMargin, SpriteMargin, SpriteMargin);
+}
+
+QPixmap VirtualKeyboard::renderKey(const KeyInfo& info, bool pressed, qreal dpr) const {
+    const QSize size = info.geometry.size() + QSize(2 * SpriteMargin, 2 * SpriteMargin);
+    QPixmap pixmap(size * dpr);
+    pixmap.setDevicePixelRatio(dpr);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
     painter.setRenderHint(QPainter::Antialiasing);
 
+    const QRect rect(QPoint(SpriteMargin, SpriteMargin), info.geometry.size());
+    painter.setBrush(pressed ? m_keyPressedColor : m_keyNormalColor);
+    painter.setPen(m_keyBorderColor);
+    painter.drawRoundedRect(rect, 6, 6);
+
+    painter.setPen(m_textColor);
+    QFont font = painter.font();
+    font.setBold(true);
+    font.setPixelSize(14);
+    painter.setFont(font);
+    painter.drawText(rect, Qt::AlignCenter, info.label);
+
+    return pixmap;
+}
+
+void VirtualKeyboard::rebuildSprites() {
+    m_sprites.clear();
+    m_spriteDpr = devicePixelRatioF();
+    if (!m_layout) return;
+
+    m_sprites.reserve(m_layout->keys().size());
+    for (const KeyInfo& info : m_layout->keys()) {
+        KeySprite sprite;
+        sprite.normal = renderKey(info, false, m_spriteDpr);
+        sprite.pressed = renderKey(info, true, m_spriteDpr);
+        m_sprites.push_back(sprite);
+    }
+}
+
+void VirtualKeyboard::paintEvent(QPaintEvent* event) {
     if (!m_layout) {
         return;
     }
+    const qint64 startNs = Metrics::now();
 
-    auto it = m_layout->keys().constBegin();
-    while (it != m_layout->keys().constEnd()) {
-        const KeyInfo& info = it.value();
-        QRect rect = info.geometry;
-        rect.translate(10, 10);
-
-        bool pressed = m_pressedKeys.contains(info.vkCode);
-        QColor bgColor = pressed ? m_keyPressedColor : m_keyNormalColor;
+    // Sprites are re-rendered when the layout changes or the window moves
+    // to a screen with a different scale factor.
+    if (m_spriteDpr != devicePixelRatioF()) {
+        rebuildSprites();
+    }
 
-        painter.setBrush(bgColor);
-        painter.setPen(m_keyBorderColor);
-        painter.drawRoundedRect(rect, 6, 6);
+    QPainter painter(this);
+    const QRect dirty = event->rect();
 
-        painter.setPen(m_textColor);
-        QFont font = painter.font();
-        font.setBold(true);
-        font.setPixelSize(14);
-        painter.setFont(font);
-        painter.drawText(rect, Qt::AlignCenter, info.label);
-        ++it;
+    // Sprites are indexed like the layout's keys.
+    const std::vector<KeyInfo>& keys = m_layout->keys();
+    const size_t count = qMin(keys.size(), m_sprites.size());
+    for (size_t i = 0; i < count; ++i) {
+        const QRect rect = spriteRect(keys[i]);
+        if (!dirty.intersects(rect)) {
+            continue;
+        }
+        const KeySprite& sprite = m_sprites[i];
+        const bool pressed = m_pressedKeys.contains(keys[i].vkCode);
+        painter.drawPixmap(rect.topLeft(), pressed ? sprite.pressed : sprite.normal);
     }
+    Metrics::instance()->timing(Metrics::Paint, startNs);
 }
@@ -21,7 +21,10 @@
 #include <QSet>
 #include <QMap>
 #include <QSize>
+#include <QPixmap>
+#include <vector>
 #include "keylayout.h"
+#include "renderscheduler.h"
 
 class VirtualKeyboard : public QWidget {
     Q_OBJECT
@@ -29,6 +32,9 @@ class VirtualKeyboard : public QWidget {
 public:
     explicit VirtualKeyboard(QWidget* parent = nullptr);
     void setLayout(KeyLayout* layout);
+    // With a scheduler, key changes are repainted on its next frame
+    // instead of immediately.
+    void setRenderScheduler(RenderScheduler* scheduler);
 
     QSize sizeHint() const override;
 
@@ -36,6 +42,7 @@ public slots:
     void onKeyPressed(int vkCode);
     void onKeyReleased(int vkCode);
     void updatePressedKeys(const QSet<int>& keys);
+    void repaintKeys(const VkBitmap& keys);
 
 signals:
     void keyClicked(int vkCode);
@@ -44,7 +51,25 @@ protected:
     void paintEvent(QPaintEvent* event) override;
 
 private:
+    // Each key is rendered once per state into a pixmap at the widget's
+    // device pixel ratio; painting a key is then a single blit.
+    struct KeySprite {
+        QPixmap normal;
+        QPixmap pressed;
+    };
+
+    static constexpr int KeyOffset = 10;
+    static constexpr int SpriteMargin = 1;  // room for the antialiased border
+
+    QRect spriteRect(const KeyInfo& info) const;
+    QPixmap renderKey(const KeyInfo& info, bool pressed, qreal dpr) const;
+    void rebuildSprites();
+    void updateKey(int vkCode);
+
     KeyLayout* m_layout = nullptr;
+    RenderScheduler* m_scheduler = nullptr;
+    std::vector<KeySprite> m_sprites;   // one per layout key
+    qreal m_spriteDpr = 0;
     QSet<int> m_pressedKeys;
     QMap<int, int> m_keyCounts;
 
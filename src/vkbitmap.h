@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef VKBITMAP_H
+#define VKBITMAP_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+// Set of virtual-key codes (0-255) stored as four 64-bit words. Membership
+// is a shift and mask, count() is four popcounts and iteration skips empty
+// words and walks set bits with count-trailing-zeros.
+class VkBitmap {
+public:
+    static constexpr int Size = 256;
+    static constexpr int WordCount = Size / 64;
+
+    class const_iterator {
+    public:
+        const_iterator(const quint64* words, int index)
+            : m_words(words)
+            , m_index(index)
+            , m_bits(index < WordCount ? words[index] : 0)
+        {
+            skipEmptyWords();
+        }
+
+        int operator*() const {
+            return m_index * 64 + static_cast<int>(qCountTrailingZeroBits(m_bits));
+        }
+
+        const_iterator& operator++() {
+            m_bits &= m_bits - 1;
+            skipEmptyWords();
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return m_index == other.m_index && m_bits == other.m_bits;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        void skipEmptyWords() {
+            while (m_bits == 0 && m_index < WordCount) {
+                if (++m_index < WordCount) {
+                    m_bits = m_words[m_index];
+                }
+            }
+        }
+
+        const quint64* m_words;
+        int m_index;
+        quint64 m_bits;
+    };
+
+    static bool isValid(int vkCode) { return static_cast<unsigned>(vkCode) < Size; }
+
+    bool contains(int vkCode) const {
+        return isValid(vkCode) && (m_words[vkCode >> 6] >> (vkCode & 63)) & 1;
+    }
+
+    void insert(int vkCode) {
+        if (isValid(vkCode)) {
+            m_words[vkCode >> 6] |= quint64(1) << (vkCode & 63);
+        }
+    }
+
+    void remove(int vkCode) {
+        if (isValid(vkCode)) {
+            m_words[vkCode >> 6] &= ~(quint64(1) << (vkCode & 63));
+        }
+    }
+
+    void clear() {
+        for (quint64& word : m_words) {
+            word = 0;
+        }
+    }
+
+    bool isEmpty() const {
+        return (m_words[0] | m_words[1] | m_words[2] | m_words[3]) == 0;
+    }
+
+    int count() const {
+        return static_cast<int>(qPopulationCount(m_words[0]) + qPopulationCount(m_words[1])
+                              + qPopulationCount(m_words[2]) + qPopulationCount(m_words[3]));
+    }
+
+    const quint64* words() const { return m_words; }
+
+    bool operator==(const VkBitmap& other) const {
+        return m_words[0] == other.m_words[0] && m_words[1] == other.m_words[1]
+            && m_words[2] == other.m_words[2] && m_words[3] == other.m_words[3];
+    }
+    bool operator!=(const VkBitmap& other) const { return !(*this == other); }
+
+    const_iterator begin() const { return const_iterator(m_words, 0); }
+    const_iterator end() const { return const_iterator(m_words, WordCount); }
+
+private:
+    quint64 m_words[WordCount] = {};
+};
+
+#endif
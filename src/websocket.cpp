@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "websocket.h"
+#include <QCryptographicHash>
+
+namespace WebSocket {
+
+QByteArray acceptKey(const QByteArray& clientKey) {
+    static const QByteArray guid = "258EAFA5-E914-47DA-95CA-C5AB0DC11B65";
+    return QCryptographicHash::hash(clientKey.trimmed() + guid, QCryptographicHash::Sha1).toBase64();
+}
+
+QByteArray encodeFrame(Opcode opcode, const QByteArray& payload) {
+    QByteArray frame;
+    const qint64 size = payload.size();
+    frame.reserve(static_cast<int>(size) + 10);
+    frame.append(static_cast<char>(0x80 | opcode));
+
+    if (size < 126) {
+        frame.append(static_cast<char>(size));
+    } else if (size <= 0xFFFF) {
+        frame.append(static_cast<char>(126));
+        frame.append(static_cast<char>((size >> 8) & 0xFF));
+        frame.append(static_cast<char>(size & 0xFF));
+    } else {
+        frame.append(static_cast<char>(127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.append(static_cast<char>((size >> shift) & 0xFF));
+        }
+    }
+
+    frame.append(payload);
+    return frame;
+}
+
+DecodeResult decodeFrame(QByteArray& buffer, Frame& frame, int maxPayload) {
+    const int available = buffer.size();
+    if (available < 2) {
+        return Incomplete;
+    }
+
+    const quint8* data = reinterpret_cast<const quint8*>(buffer.constData());
+    const bool masked = data[1] & 0x80;
+    if (!masked || (data[0] & 0x70)) {
+        return ProtocolError;
+    }
+    const quint8 opcode = data[0] & 0x0F;
+    const bool final = data[0] & 0x80;
+    switch (opcode) {
+    case Continuation:
+    case Text:
+    case Binary:
+    case Close:
+    case Ping:
+    case Pong:
+        break;
+    default:
+        return ProtocolError;
+    }
+
+    quint64 length = data[1] & 0x7F;
+    int offset = 2;
+    if (length == 126) {
+        if (available < 4) {
+            return Incomplete;
+        }
+        length = (data[2] << 8) | data[3];
+        offset = 4;
+    } else if (length == 127) {
+        if (available < 10) {
+            return Incomplete;
+        }
+        // The most significant bit of a 64-bit length must be 0.
+        if (data[2] & 0x80) {
+            return ProtocolError;
+        }
+        length = 0;
+        for (int i = 2; i < 10; ++i) {
+            length = (length << 8) | data[i];
+        }
+        offset = 10;
+    }
+
+    // Control frames carry at most 125 bytes and are never fragmented.
+    if ((opcode & 0x08) && (length > 125 || !final)) {
+        return ProtocolError;
+    }
+    if (maxPayload < 0 || length > static_cast<quint64>(maxPayload)) {
+        return ProtocolError;
+    }
+    const int size = static_cast<int>(length);
+    if (available < offset + 4 + size) {
+        return Incomplete;
+    }
+
+    const quint8* mask = data + offset;
+    offset += 4;
+
+    frame.opcode = opcode;
+    frame.final = final;
+    frame.payload.resize(size);
+    char* out = frame.payload.data();
+    for (int i = 0; i < size; ++i) {
+        out[i] = static_cast<char>(data[offset + i] ^ mask[i & 3]);
+    }
+
+    buffer.remove(0, offset + size);
+    return Decoded;
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 Akuta Zehy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <QByteArray>
+
+// Minimal RFC 6455 framing for the server side: handshake accept key,
+// unmasked outgoing frames and masked incoming frames.
+namespace WebSocket {
+
+enum Opcode : quint8 {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+struct Frame {
+    quint8 opcode = 0;
+    bool final = true;
+    QByteArray payload;
+};
+
+enum DecodeResult {
+    Incomplete,
+    Decoded,
+    ProtocolError
+};
+
+QByteArray acceptKey(const QByteArray& clientKey);
+
+QByteArray encodeFrame(Opcode opcode, const QByteArray& payload);
+
+// Removes one complete frame from the front of buffer. Client frames must
+// be masked and no larger than maxPayload; control frames must be final and
+// at most 125 bytes, and unknown opcodes are rejected. Fragments are
+// returned as they arrive, for the caller to reassemble.
+DecodeResult decodeFrame(QByteArray& buffer, Frame& frame, int maxPayload);
+
+}
+
+#endif